@@ -0,0 +1,266 @@
+#ifndef cetlib_cache_codec_h
+#define cetlib_cache_codec_h
+
+// ====================================================================
+// The cache_codec class template is the customization point used by
+// the concurrent_cache to store cold, retained entries in compressed
+// form (see the cache_option::compress_retained option in
+// concurrent_cache.h).
+//
+// A codec for type T provides two static member functions:
+//
+//   template <>
+//   struct cet::cache_codec<MyCalibrationTable> {
+//     static std::vector<std::byte> compress(MyCalibrationTable const&);
+//     static MyCalibrationTable decompress(std::vector<std::byte> const&);
+//   };
+//
+// Codecs are provided for trivially copyable (and default-constructible)
+// types and for std::vector and std::basic_string specializations of
+// trivially copyable element types, except for std::vector<bool>,
+// whose elements are not stored contiguously.  These default codecs use a
+// simple, byte-oriented LZ77 scheme that favors speed over compression
+// ratio.  Users may specialize cache_codec for any other type they
+// would like to be compressible.  A codec may return an empty buffer
+// to indicate that a value is not worth compressing; the entry holding
+// that value is then not submitted to the codec again.
+// ====================================================================
+
+#include "cetlib_except/exception.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cet::detail {
+
+  // The LZ format is a sequence of operations, each introduced by a
+  // control byte c:
+  //
+  //   c <  0x80: a run of (c + 1) literal bytes follows
+  //   c >= 0x80: copy (c & 0x7f) + min_match bytes from the
+  //              already-decoded output, at a distance given by the
+  //              next two bytes (little endian)
+  //
+  // The decoded size is stored in an 8-byte header.
+  namespace lz {
+    constexpr std::size_t header_size = sizeof(std::uint64_t);
+    constexpr std::size_t min_match = 4;
+    constexpr std::size_t max_match = 0x7f + min_match;
+    constexpr std::size_t max_literals = 0x80;
+    constexpr std::size_t max_distance = 0xffff;
+    constexpr std::size_t hash_bits = 12;
+
+    inline std::uint32_t
+    read32(std::byte const* p) noexcept
+    {
+      std::uint32_t result;
+      std::memcpy(&result, p, sizeof(result));
+      return result;
+    }
+
+    inline std::size_t
+    hash(std::uint32_t const v) noexcept
+    {
+      return (v * 2654435761u) >> (32 - hash_bits);
+    }
+  }
+
+  inline std::vector<std::byte>
+  lz_compress(std::byte const* const data, std::size_t const n)
+  {
+    using namespace lz;
+    std::vector<std::byte> result(header_size);
+    std::uint64_t const size = n;
+    std::memcpy(result.data(), &size, header_size);
+    result.reserve(header_size + n / 2);
+
+    auto flush_literals = [&result, data](std::size_t begin, std::size_t const end) {
+      while (begin != end) {
+        auto const count = std::min(end - begin, max_literals);
+        result.push_back(static_cast<std::byte>(count - 1));
+        result.insert(result.end(), data + begin, data + begin + count);
+        begin += count;
+      }
+    };
+
+    std::array<std::size_t, 1u << hash_bits> last_seen{};
+    last_seen.fill(-1ull);
+    std::size_t literal_start{};
+    std::size_t i{};
+    while (i + min_match <= n) {
+      auto const h = hash(read32(data + i));
+      auto const candidate = last_seen[h];
+      last_seen[h] = i;
+      if (candidate == -1ull or i - candidate > max_distance or
+          read32(data + candidate) != read32(data + i)) {
+        ++i;
+        continue;
+      }
+
+      std::size_t length = min_match;
+      while (i + length < n and length < max_match and data[candidate + length] == data[i + length]) {
+        ++length;
+      }
+
+      flush_literals(literal_start, i);
+      auto const distance = i - candidate;
+      result.push_back(static_cast<std::byte>(0x80 | (length - min_match)));
+      result.push_back(static_cast<std::byte>(distance & 0xff));
+      result.push_back(static_cast<std::byte>(distance >> 8));
+      i += length;
+      literal_start = i;
+    }
+    flush_literals(literal_start, n);
+    return result;
+  }
+
+  inline std::size_t
+  lz_decompressed_size(std::vector<std::byte> const& compressed)
+  {
+    if (std::size(compressed) < lz::header_size) {
+      throw cet::exception("Cache codec error.") << "Compressed buffer is truncated.";
+    }
+    std::uint64_t size;
+    std::memcpy(&size, compressed.data(), lz::header_size);
+    return size;
+  }
+
+  inline void
+  lz_decompress(std::vector<std::byte> const& compressed, std::byte* const out, std::size_t const n)
+  {
+    using namespace lz;
+    if (lz_decompressed_size(compressed) != n) {
+      throw cet::exception("Cache codec error.")
+        << "Decompressed size does not match the expected size of " << n << " bytes.";
+    }
+
+    auto in = compressed.data() + header_size;
+    auto const in_end = compressed.data() + std::size(compressed);
+    std::size_t written{};
+    while (in != in_end) {
+      auto const control = std::to_integer<std::size_t>(*in++);
+      if (control < 0x80) {
+        auto const count = control + 1;
+        if (static_cast<std::size_t>(in_end - in) < count or written + count > n) {
+          throw cet::exception("Cache codec error.") << "Corrupt literal run.";
+        }
+        std::memcpy(out + written, in, count);
+        in += count;
+        written += count;
+        continue;
+      }
+
+      if (in_end - in < 2) {
+        throw cet::exception("Cache codec error.") << "Corrupt match header.";
+      }
+      auto const length = (control & 0x7f) + min_match;
+      auto const distance = std::to_integer<std::size_t>(in[0]) |
+                            (std::to_integer<std::size_t>(in[1]) << 8);
+      in += 2;
+      if (distance == 0 or distance > written or written + length > n) {
+        throw cet::exception("Cache codec error.") << "Corrupt match reference.";
+      }
+      // Matches may overlap the bytes being written; copy one byte at
+      // a time.
+      for (std::size_t j{}; j != length; ++j, ++written) {
+        out[written] = out[written - distance];
+      }
+    }
+
+    if (written != n) {
+      throw cet::exception("Cache codec error.") << "Compressed buffer is truncated.";
+    }
+  }
+}
+
+namespace cet {
+
+  template <typename T, typename = void>
+  struct cache_codec;
+
+  template <typename T>
+  struct cache_codec<
+    T,
+    std::enable_if_t<std::is_trivially_copyable_v<T> and std::is_default_constructible_v<T>>> {
+    static std::vector<std::byte>
+    compress(T const& t)
+    {
+      return detail::lz_compress(reinterpret_cast<std::byte const*>(&t), sizeof(T));
+    }
+
+    static T
+    decompress(std::vector<std::byte> const& bytes)
+    {
+      T result;
+      detail::lz_decompress(bytes, reinterpret_cast<std::byte*>(&result), sizeof(T));
+      return result;
+    }
+  };
+
+  template <typename E, typename A>
+  struct cache_codec<
+    std::vector<E, A>,
+    std::enable_if_t<std::is_trivially_copyable_v<E> and not std::is_same_v<E, bool>>> {
+    static std::vector<std::byte>
+    compress(std::vector<E, A> const& v)
+    {
+      return detail::lz_compress(reinterpret_cast<std::byte const*>(v.data()),
+                                 std::size(v) * sizeof(E));
+    }
+
+    static std::vector<E, A>
+    decompress(std::vector<std::byte> const& bytes)
+    {
+      auto const n = detail::lz_decompressed_size(bytes);
+      std::vector<E, A> result(n / sizeof(E));
+      detail::lz_decompress(bytes, reinterpret_cast<std::byte*>(result.data()), n);
+      return result;
+    }
+  };
+
+  template <typename C, typename Tr, typename A>
+  struct cache_codec<std::basic_string<C, Tr, A>, std::enable_if_t<std::is_trivially_copyable_v<C>>> {
+    static std::vector<std::byte>
+    compress(std::basic_string<C, Tr, A> const& s)
+    {
+      return detail::lz_compress(reinterpret_cast<std::byte const*>(s.data()),
+                                 std::size(s) * sizeof(C));
+    }
+
+    static std::basic_string<C, Tr, A>
+    decompress(std::vector<std::byte> const& bytes)
+    {
+      auto const n = detail::lz_decompressed_size(bytes);
+      std::basic_string<C, Tr, A> result(n / sizeof(C), C{});
+      detail::lz_decompress(bytes, reinterpret_cast<std::byte*>(result.data()), n);
+      return result;
+    }
+  };
+}
+
+namespace cet::detail {
+  template <typename T, typename = void>
+  struct has_cache_codec : std::false_type {};
+
+  template <typename T>
+  struct has_cache_codec<
+    T,
+    std::void_t<decltype(cache_codec<T>::compress(std::declval<T const&>())),
+                decltype(cache_codec<T>::decompress(std::declval<std::vector<std::byte> const&>()))>>
+    : std::true_type {};
+
+  template <typename T>
+  constexpr bool has_cache_codec_v = has_cache_codec<T>::value;
+}
+
+#endif /* cetlib_cache_codec_h */
+
+// Local Variables:
+// mode: c++
+// End:
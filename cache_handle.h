@@ -25,6 +25,11 @@
 //   - Access to the underlying entry's const-qualified member
 //     functions is provided via operator->.
 //
+// For interfaces that require a std::shared_ptr<V const>, the
+// to_shared_ptr(h) function returns a shared pointer to the entry's
+// value that keeps the entry pinned for as long as the pointer (or
+// any copy of it) exists.
+//
 // N.B. A handle cannot in any way adjust the underlying value.  It is
 //      considered immutable.
 // ====================================================================
@@ -33,8 +38,17 @@
 #include "cetlib/exempt_ptr.h"
 #include "cetlib_except/exception.h"
 
+#include <memory>
+
 namespace cet {
 
+  template <typename V>
+  class weak_cache_handle;
+  template <typename U>
+  class cache_handle_view;
+  template <typename K, typename V>
+  class concurrent_cache;
+
   template <typename V>
   class cache_handle {
   public:
@@ -54,6 +68,23 @@ namespace cet {
       }
     }
 
+    // Moving a handle transfers the reference without adjusting the
+    // reference count.
+    cache_handle(cache_handle&& other) noexcept : entry_{other.entry_} { other.entry_ = nullptr; }
+
+    cache_handle&
+    operator=(cache_handle&& other) noexcept
+    {
+      if (entry_ == other.entry_) {
+        other.invalidate();
+        return *this;
+      }
+      invalidate();
+      entry_ = other.entry_;
+      other.entry_ = nullptr;
+      return *this;
+    }
+
     cache_handle&
     operator=(cache_handle const& other)
     {
@@ -104,9 +135,40 @@ namespace cet {
     ~cache_handle() { invalidate(); }
 
   private:
+    template <typename, typename>
+    friend class concurrent_cache;
+    template <typename>
+    friend class weak_cache_handle;
+    template <typename>
+    friend class cache_handle_view;
+
+    struct adopt_reference_t {};
+
+    // Takes over a reference that has already been acquired.
+    cache_handle(detail::concurrent_cache_entry<V>& entry, adopt_reference_t) noexcept
+      : entry_{cet::make_exempt_ptr(&entry)}
+    {}
+
     cet::exempt_ptr<detail::concurrent_cache_entry<V>> entry_{nullptr};
   };
 
+  // Returns a shared pointer to the handle's value, whose control block
+  // keeps the entry pinned until the last copy of the shared pointer
+  // is destroyed.  The value itself is not copied.  An invalid handle
+  // yields a null pointer.
+  template <typename V>
+  std::shared_ptr<V const>
+  to_shared_ptr(cache_handle<V> h)
+  {
+    if (not h) {
+      return nullptr;
+    }
+    V const* value = &*h;
+    return std::shared_ptr<V const>{value, [pin = std::move(h)](V const*) mutable {
+                                      pin.invalidate();
+                                    }};
+  }
+
 }
 
 #endif /* cetlib_cache_handle_h */
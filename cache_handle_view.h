@@ -0,0 +1,192 @@
+#ifndef cetlib_cache_handle_view_h
+#define cetlib_cache_handle_view_h
+
+// ====================================================================
+// A cache_handle_view refers to a sub-object of a cache entry's value
+// while keeping the entry pinned, in the style of the aliasing
+// constructor of std::shared_ptr.  It allows handing out a part of a
+// large value without copying it, and without exposing the value's
+// type to the recipient:
+//
+//   concurrent_cache<K, CalibrationTable> cache;
+//   auto h = cache.at(key);
+//   cache_handle_view<Row> row = project(h, [channel](auto const& table) -> Row const& {
+//     return table.rows[channel];
+//   });
+//   cache_handle_view<Header> header = project(std::move(h), &CalibrationTable::header);
+//
+// The projection may be any callable (including a pointer to data
+// member) that returns a reference to an object whose lifetime is
+// bound to that of the value.  Views may themselves be projected.
+//
+// As for cache handles, the referred-to object is immutable, and a
+// view must not outlive the cache whose entry it pins.
+// ====================================================================
+
+#include "cetlib/cache_handle.h"
+#include "cetlib/concurrent_cache_entry.h"
+#include "cetlib/exempt_ptr.h"
+#include "cetlib_except/exception.h"
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace cet {
+
+  template <typename U>
+  class cache_handle_view {
+  public:
+    cache_handle_view() = default;
+
+    // Aliasing constructors: the view pins the entry of h, but refers
+    // to u, which must be a sub-object of the entry's value.
+    template <typename V>
+    cache_handle_view(cache_handle<V> const& h, U const& u)
+      : cache_handle_view{cache_handle<V>{h}, u}
+    {}
+
+    template <typename V>
+    cache_handle_view(cache_handle<V>&& h, U const& u)
+    {
+      if (not h) {
+        throw exception("Invalid cache handle projection.")
+          << "Handle does not refer to any cache entry.";
+      }
+      // Take over the handle's reference.
+      count_ = cet::make_exempt_ptr(h.entry_->counter().get());
+      h.entry_ = nullptr;
+      value_ = &u;
+    }
+
+    template <typename W>
+    cache_handle_view(cache_handle_view<W> const& other, U const& u)
+      : cache_handle_view{cache_handle_view<W>{other}, u}
+    {}
+
+    template <typename W>
+    cache_handle_view(cache_handle_view<W>&& other, U const& u)
+    {
+      if (not other) {
+        throw exception("Invalid cache handle projection.")
+          << "View does not refer to any cache entry.";
+      }
+      count_ = other.count_;
+      other.count_ = nullptr;
+      other.value_ = nullptr;
+      value_ = &u;
+    }
+
+    cache_handle_view(cache_handle_view const& other) : count_{other.count_}, value_{other.value_}
+    {
+      if (count_) {
+        // The entry is already pinned by other; it can be neither
+        // erased nor compressed.
+        ++count_->use_count;
+      }
+    }
+
+    cache_handle_view(cache_handle_view&& other) noexcept
+      : count_{other.count_}, value_{other.value_}
+    {
+      other.count_ = nullptr;
+      other.value_ = nullptr;
+    }
+
+    cache_handle_view&
+    operator=(cache_handle_view other) noexcept
+    {
+      std::swap(count_, other.count_);
+      std::swap(value_, other.value_);
+      return *this;
+    }
+
+    ~cache_handle_view() { invalidate(); }
+
+    explicit operator bool() const noexcept { return value_ != nullptr; }
+
+    U const&
+    operator*() const
+    {
+      if (value_ == nullptr) {
+        throw exception("Invalid cache handle dereference.")
+          << "View does not refer to any cache entry.";
+      }
+      return *value_;
+    }
+
+    U const*
+    operator->() const
+    {
+      return &this->operator*();
+    }
+
+    void
+    invalidate() noexcept
+    {
+      if (count_ == nullptr) {
+        return;
+      }
+      count_->release();
+      count_ = nullptr;
+      value_ = nullptr;
+    }
+
+  private:
+    template <typename>
+    friend class cache_handle_view;
+
+    cet::exempt_ptr<detail::entry_count> count_{nullptr};
+    U const* value_{nullptr};
+  };
+
+  // See to_shared_ptr(cache_handle<V>) in cache_handle.h.
+  template <typename U>
+  std::shared_ptr<U const>
+  to_shared_ptr(cache_handle_view<U> v)
+  {
+    if (not v) {
+      return nullptr;
+    }
+    U const* value = &*v;
+    return std::shared_ptr<U const>{value, [pin = std::move(v)](U const*) mutable {
+                                      pin.invalidate();
+                                    }};
+  }
+
+  namespace detail {
+    template <typename T, typename F>
+    using projected_t = std::remove_cv_t<std::remove_reference_t<std::invoke_result_t<F, T const&>>>;
+  }
+
+  template <typename V, typename F>
+  auto
+  project(cache_handle<V> h, F&& f)
+  {
+    static_assert(
+      std::is_reference_v<std::invoke_result_t<F, V const&>>,
+      "A cache-handle projection must return a reference to a sub-object of the value.");
+    using U = detail::projected_t<V, F>;
+    U const& u = std::invoke(std::forward<F>(f), *h);
+    return cache_handle_view<U>{std::move(h), u};
+  }
+
+  template <typename W, typename F>
+  auto
+  project(cache_handle_view<W> v, F&& f)
+  {
+    static_assert(
+      std::is_reference_v<std::invoke_result_t<F, W const&>>,
+      "A cache-handle projection must return a reference to a sub-object of the value.");
+    using U = detail::projected_t<W, F>;
+    U const& u = std::invoke(std::forward<F>(f), *v);
+    return cache_handle_view<U>{std::move(v), u};
+  }
+}
+
+#endif /* cetlib_cache_handle_view_h */
+
+// Local Variables:
+// mode: c++
+// End:
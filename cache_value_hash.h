@@ -0,0 +1,94 @@
+#ifndef cetlib_cache_value_hash_h
+#define cetlib_cache_value_hash_h
+
+// ====================================================================
+// The cache_value_hash class template is the customization point used
+// by the concurrent_cache to hash cached values when value
+// deduplication is enabled (see the cache_option::deduplicate_values
+// option in concurrent_cache.h).
+//
+// A value hash for type T is a function object:
+//
+//   template <>
+//   struct cet::cache_value_hash<MyCalibrationTable> {
+//     std::size_t operator()(MyCalibrationTable const&) const;
+//   };
+//
+// Value hashes are provided for all types that have an enabled
+// std::hash specialization, and for std::vector specializations of
+// trivially copyable element types, whose bytes are hashed.  Two
+// values with the same hash are deduplicated only if they also
+// compare equal with operator==.
+// ====================================================================
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace cet::detail {
+  template <typename T, typename = void>
+  struct is_std_hashable : std::false_type {};
+
+  template <typename T>
+  struct is_std_hashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<T const&>()))>>
+    : std::true_type {};
+
+  template <typename T>
+  constexpr bool is_std_hashable_v = is_std_hashable<T>::value;
+
+  inline std::size_t
+  hash_bytes(void const* const data, std::size_t const n)
+  {
+    return std::hash<std::string_view>{}(std::string_view{static_cast<char const*>(data), n});
+  }
+}
+
+namespace cet {
+
+  template <typename T, typename = void>
+  struct cache_value_hash;
+
+  template <typename T>
+  struct cache_value_hash<T, std::enable_if_t<detail::is_std_hashable_v<T>>> {
+    std::size_t
+    operator()(T const& t) const
+    {
+      return std::hash<T>{}(t);
+    }
+  };
+
+  template <typename E, typename A>
+  struct cache_value_hash<
+    std::vector<E, A>,
+    std::enable_if_t<std::is_trivially_copyable_v<E> and
+                     not detail::is_std_hashable_v<std::vector<E, A>>>> {
+    std::size_t
+    operator()(std::vector<E, A> const& v) const
+    {
+      return detail::hash_bytes(v.data(), std::size(v) * sizeof(E));
+    }
+  };
+}
+
+namespace cet::detail {
+  template <typename T, typename = void>
+  struct is_deduplicable : std::false_type {};
+
+  template <typename T>
+  struct is_deduplicable<
+    T,
+    std::void_t<decltype(cache_value_hash<T>{}(std::declval<T const&>())),
+                decltype(std::declval<T const&>() == std::declval<T const&>())>>
+    : std::true_type {};
+
+  template <typename T>
+  constexpr bool is_deduplicable_v = is_deduplicable<T>::value;
+}
+
+#endif /* cetlib_cache_value_hash_h */
+
+// Local Variables:
+// mode: c++
+// End:
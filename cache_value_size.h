@@ -0,0 +1,59 @@
+#ifndef cetlib_cache_value_size_h
+#define cetlib_cache_value_size_h
+
+// ====================================================================
+// The cache_value_size class template is the customization point used
+// by the concurrent_cache to estimate the memory occupied by a cached
+// value (see memory_governor.h).
+//
+// A value size for type T is a function object returning a number of
+// bytes:
+//
+//   template <>
+//   struct cet::cache_value_size<MyCalibrationTable> {
+//     std::size_t operator()(MyCalibrationTable const&) const;
+//   };
+//
+// By default, the size of a value is sizeof(T), plus the heap memory
+// of types that provide a capacity() member function and a value_type
+// (e.g. std::vector and std::basic_string specializations).  Memory
+// owned through other means is not accounted for unless cache_value_size
+// is specialized.
+// ====================================================================
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace cet::detail {
+  template <typename T, typename = void>
+  struct has_capacity : std::false_type {};
+
+  template <typename T>
+  struct has_capacity<T,
+                      std::void_t<decltype(std::declval<T const&>().capacity()),
+                                  typename T::value_type>> : std::true_type {};
+}
+
+namespace cet {
+
+  template <typename T, typename = void>
+  struct cache_value_size {
+    std::size_t
+    operator()(T const& t) const
+    {
+      if constexpr (detail::has_capacity<T>::value) {
+        return sizeof(T) + t.capacity() * sizeof(typename T::value_type);
+      }
+      else {
+        return sizeof(T);
+      }
+    }
+  };
+}
+
+#endif /* cetlib_cache_value_size_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -17,6 +17,37 @@
 // unless all handles referring to that object have been destroyed or
 // invalidated.
 //
+// Entries are created with emplace(key, value), which returns a handle
+// to the existing entry if the key is already present, or with
+// try_emplace(key, args...), which constructs the value from 'args'
+// only if the key is not yet present.  Both functions accept keys
+// by rvalue, in which case the key is moved into the cache.
+//
+// Each key is hashed once per cache operation (see hashed_key.h).  A
+// key that is used for many lookups can be hashed once by wrapping it
+// in a prehashed_key, and caches with string keys can be probed with
+// string views or character strings without creating a temporary
+// key:
+//
+//   prehashed_key const key{std::string{"Alice"}};
+//   auto h1 = cache.at(key);
+//   auto h2 = cache.at("Alice");
+//
+// Bulk construction
+// -----------------
+//
+// A cache can be constructed from a range of (key, value) pairs, which
+// are then emplaced in parallel:
+//
+//   std::vector<std::pair<K, V>> const pairs{...};
+//   concurrent_cache<K, V> cache{begin(pairs), end(pairs)};
+//
+// The cache's maps are sized for the number of pairs before any entry
+// is emplaced, and the entries' identifiers (see Technical notes) are
+// assigned in blocks, one block per parallel task.  A cache that is
+// to be populated by many concurrent emplace(...) calls can similarly
+// be sized in advance with reserve(n).
+//
 // Cache cleanup and entry retention
 // ---------------------------------
 //
@@ -27,11 +58,64 @@
 // where n is an unsigned integer indicating the n "most recently
 // created", yet unused, entries that should be retained.
 //
+// Compression of retained entries
+// --------------------------------
+//
+// Entries that are retained by drop_unused_but_last(n) but that are
+// not referred to by any handle can be stored in compressed form.
+// This mode is enabled by constructing the cache with the
+// cache_option::compress_retained option:
+//
+//   concurrent_cache<K, V> cache{cache_option::compress_retained};
+//
+// The compression is performed by the cet::cache_codec<V>
+// customization point (see cache_codec.h).  A compressed entry is
+// transparently decompressed the next time a handle to it is created.
+// It is an error to request this mode if no codec is available for V.
+//
+// Value deduplication
+// -------------------
+//
+// It frequently happens that distinct keys correspond to values that
+// compare equal (e.g. constants that did not change between two
+// intervals of validity).  With the cache_option::deduplicate_values
+// option, each emplaced value is hashed (see cache_value_hash.h) and
+// stored only once, in a content-addressed pool; all entries whose
+// values compare equal then share the same immutable payload.  The
+// payload is destroyed once the last entry referring to it has been
+// erased.  It is an error to request this mode if V does not provide
+// both a cet::cache_value_hash specialization and operator==.
+//
+// N.B. A deduplicated payload is compressed only if it is referred to
+//      by a single entry.
+//
+// Memory budgets
+// --------------
+//
+// Any number of caches can share one memory budget by joining the
+// same memory_governor (see memory_governor.h):
+//
+//   memory_governor governor{budget_in_bytes};
+//   cache.join(governor, weight);
+//
+// After each emplace(...) or try_emplace(...) call that makes the
+// governed caches exceed the budget, unused entries are dropped from
+// the caches that use the most memory relative to their weights.
+// The emplace_nowait(...) function does not wait for memory to be
+// reclaimed; the budget is then enforced by the next emplacement.
+// The budget can also follow the memory limit of the process (see
+// memory_monitor.h).
+//
 // Concurrent operations
 // ---------------------
 //
-// With the exception of shrink_to_fit, all member functions may be
-// called concurrently.  Any locking is handled internally by TBB.  In
+// With the exception of reserve, join and shrink_to_fit, all member
+// functions may be called concurrently.  Each entry is protected by a
+// lock provided by TBB.  In addition, the cache uses a few internal
+// locks of its own: updates of the interval index are serialized by a
+// mutex, as are emplacements in the coalescing and overlap-handling
+// modes (see below), and writers announce themselves on per-cache
+// stripes so that the non-blocking functions can detect them.  In
 // order to provide the entry_for(...) functionality and not incur
 // locking, an auxiliary data member was introduced that cannot shrink
 // during concurrent processing.  This is likely to be a problem only
@@ -73,12 +157,162 @@
 //      return true.  It is a runtime error for more than one key to
 //      support the same value.
 //
+// Interval keys
+// -------------
+//
+// A user-defined key is an interval key if, in addition to the
+// supports(...) interface, it describes a half-open interval [b, e)
+// through 'begin()' and 'end()' member functions, and it can be
+// constructed from such a pair of bounds:
+//
+//   struct range_of_values {
+//     ...
+//     range_of_values(unsigned b, unsigned e);
+//     unsigned begin() const;
+//     unsigned end() const;
+//   };
+//
+// Ready-made interval keys over (run, subrun, event) identifiers and
+// over 64-bit timestamps are provided in interval.h.
+//
+// For interval keys, the cache maintains an ordered index of all
+// keys, and the entry_for(t) call is resolved by a binary search
+// whenever t is convertible to the type of the bounds and no two
+// keys overlap.  For ordered streams of values, an iov_cursor (see
+// iov_cursor.h) can be used to track the position within the index.
+//
+// Pinning many entries at once
+// ----------------------------
+//
+// The at(...) and entry_for(...) functions also accept a pinned_set
+// (see pinned_set.h), in which case the entry is pinned once for the
+// lifetime of the set, and a non-owning cache_view is returned instead
+// of a handle.  A pin_scope (see pin_scope.h) additionally remembers
+// the entries retrieved within a unit of work (e.g. an event), so that
+// repeated lookups return plain references without consulting the
+// cache at all.
+//
+// Epoch-protected reads
+// ---------------------
+//
+// Creating a handle increments the entry's reference count, which is
+// a write to memory shared by all threads that use the entry.  For
+// short-lived reads, the cache_option::epoch_protection option
+// provides an alternative:
+//
+//   concurrent_cache<K, V> cache{cache_option::epoch_protection};
+//   ...
+//   {
+//     auto const guard = cache.read_guard();
+//     if (auto v = cache.at(key, guard)) {
+//       v->some_member_function_of_type_V();
+//     }
+//   } // 'v' is invalid once the guard is destroyed
+//
+// Such reads do not pin the entry, and they neither lock the cache
+// nor write to any memory shared with other readers (see
+// epoch_domain.h).  The entries may therefore be dropped while being
+// read, but the values of dropped entries are destroyed only once no
+// guard that could observe them remains.  A guard should be held for
+// a short time (e.g. one lookup or one event) as it delays the
+// destruction of all values dropped during its lifetime.  At most 128
+// guards of a given cache may exist at once; read_guard() throws an
+// exception if that many are already in use.
+//
+// With the cache_option::optimistic_reads option, the at(...) and
+// entry_for(...) functions that return handles use the same
+// publication scheme to find the entry without locking.  The entry is
+// then pinned with a single atomic update of its reference count,
+// which fails (and the lookup is retried) only if the entry is being
+// erased concurrently.  If all read guards are in use, the lookup is
+// made as without the option.
+// The option avoids the accessor's lock, but it is not a measured
+// win: on a single-core host it is slower than the default read path,
+// with or without a contended key, and its behavior under contention
+// on several cores has not been measured (see
+// examples/read_path_benchmark.cc).
+//
+// Epoch protection and optimistic reads are incompatible with the
+// compression of retained entries.
+//
+// Dense keys
+// ----------
+//
+// For key types declared dense through the cet::is_dense_key trait
+// (see dense_table.h), e.g. run numbers or channel IDs, the at(...)
+// and entry_for(...) lookups are resolved by direct indexing into a
+// segmented array instead of by hashing.  The handle and drop
+// semantics are unchanged.  Dense keys must be non-negative and
+// smaller than 16,777,215; emplacing any other key throws an
+// exception, and looking it up finds no entry.  Dense keys are
+// incompatible with the compression of retained entries.
+//
+// Weak handles
+// ------------
+//
+// A weak_cache_handle (see weak_cache_handle.h) remembers an entry
+// without pinning it, so the entry may still be removed by the
+// drop_unused* functions.  Its lock() function returns a handle to the
+// entry if the entry still exists, and an invalid handle otherwise.
+// Locking does not consult the cache.
+//
+// Projected handles
+// -----------------
+//
+// A handle can be projected onto a sub-object of its value--e.g. one
+// row of a calibration table--with cet::project (see
+// cache_handle_view.h).  The resulting cache_handle_view keeps the
+// entry pinned, without exposing the value's type.
+//
+// Coalescing of adjacent intervals
+// --------------------------------
+//
+// For caches with interval keys and equality-comparable values, the
+// cache_option::coalesce_intervals option merges adjacent intervals
+// whose values compare equal.  Emplacing [b, c) with a value equal to
+// that of the existing entry [a, b) results in a single entry [a, c),
+// which shares the payload of [a, b) and which is the entry returned
+// by emplace.  The same holds for an existing adjacent entry [c, d).
+// Emplacing an interval that is covered by an existing entry whose
+// value compares equal (e.g. [b, c) once more) returns that entry.
+// The entries that have been merged are superseded--they are no
+// longer returned by entry_for(...), and they are erased by the next
+// drop_unused* call for which they are unused, irrespective of any
+// requested retention.  Until then, they may still be retrieved with
+// at(...).  Emplacing the key of a superseded entry replaces that
+// entry with the emplaced value.  If the superseded entry is still in
+// use, it is detached from the cache: its handles remain valid, and it
+// is destroyed by the first drop_unused* call after it becomes unused.
+//
+// Overlapping intervals
+// ---------------------
+//
+// By default, the cache accepts interval keys that overlap, leaving
+// it to entry_for(...) to report an error if more than one key
+// supports a given value.  Overlaps can instead be handled when
+// emplacing an interval, by specifying one of the following options:
+//
+//   - cache_option::reject_overlaps: emplacing an interval that
+//     overlaps with an existing one throws an exception.
+//
+//   - cache_option::newest_wins: the existing intervals are trimmed
+//     to the parts not covered by the new interval.  The trimmed
+//     parts are new entries that share the payloads of the original
+//     entries, which are superseded as described above.
+//
+// In either case, no two keys in the index overlap, and entry_for(...)
+// is always resolved with a single binary search.
+//
+// N.B. Emplacing entries is serialized in any of the coalescing or
+//      overlap-handling modes.
+//
 // Not implemented
 // ---------------
 //
-// The implementation below does not support a bounded cache.  All
-// memory management is achieved by calling the drop_unused* and
-// shrink_to_fit member functions.
+// The implementation below does not support a cache bounded by its
+// number of entries.  Apart from memory budgets, all memory management
+// is achieved by calling the drop_unused* and shrink_to_fit member
+// functions.
 //
 // Technical notes
 // ---------------
@@ -96,21 +330,83 @@
 // ===================================================================
 
 #include "cetlib/assert_only_one_thread.h"
+#include "cetlib/cache_codec.h"
 #include "cetlib/cache_handle.h"
 #include "cetlib/concurrent_cache_entry.h"
+#include "cetlib/dense_table.h"
+#include "cetlib/epoch_domain.h"
+#include "cetlib/hashed_key.h"
+#include "cetlib/interval_index.h"
+#include "cetlib/memory_governor.h"
+#include "cetlib/pinned_set.h"
+#include "cetlib/value_pool.h"
 #include "cetlib_except/exception.h"
 
+#include "tbb/blocked_range.h"
 #include "tbb/concurrent_hash_map.h"
 #include "tbb/concurrent_unordered_map.h"
+#include "tbb/parallel_for.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <type_traits>
+#include <unordered_set>
 
 namespace cet {
 
+  enum class cache_option : unsigned {
+    none = 0u,
+    compress_retained = 1u,
+    deduplicate_values = 1u << 1,
+    coalesce_intervals = 1u << 2,
+    reject_overlaps = 1u << 3,
+    newest_wins = 1u << 4,
+    epoch_protection = 1u << 5,
+    optimistic_reads = 1u << 6
+  };
+
+  constexpr cache_option
+  operator|(cache_option const a, cache_option const b) noexcept
+  {
+    return static_cast<cache_option>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+  }
+
+  constexpr bool
+  any(cache_option const a, cache_option const b) noexcept
+  {
+    return (static_cast<unsigned>(a) & static_cast<unsigned>(b)) != 0u;
+  }
+
+  namespace detail {
+    template <typename T, typename = void>
+    struct is_equality_comparable : std::false_type {};
+
+    template <typename T>
+    struct is_equality_comparable<
+      T,
+      std::void_t<decltype(std::declval<T const&>() == std::declval<T const&>())>>
+      : std::true_type {};
+
+    template <typename T>
+    constexpr bool is_equality_comparable_v = is_equality_comparable<T>::value;
+  }
+
+  template <typename K, typename V>
+  class iov_cursor;
+
+  template <typename K, typename V>
+  class pin_scope;
+
   template <typename K, typename V>
   class concurrent_cache {
     // For some cases, the user will not know what the key is.  For
@@ -129,19 +425,138 @@ namespace cet {
     struct key_supports<T, std::void_t<decltype(std::declval<K>().supports(std::declval<T>()))>>
       : std::true_type {};
 
-    using count_map_t = tbb::concurrent_unordered_map<K, detail::entry_count_ptr, std::hash<K>>;
+    static constexpr bool coalescable =
+      detail::is_interval_key_v<K> and detail::is_equality_comparable_v<V>;
+
+    static constexpr cache_option interval_options =
+      cache_option::coalesce_intervals | cache_option::reject_overlaps | cache_option::newest_wins;
+
+    using index_t = std::conditional_t<detail::is_interval_key_v<K>,
+                                       detail::interval_index<K>,
+                                       detail::no_interval_index>;
+
+    // The interval index can be used for entry_for(t) calls if t is
+    // convertible to the key's point type.
+    template <typename T, typename = void>
+    struct indexed_by : std::false_type {};
+
+    template <typename T>
+    struct indexed_by<T, std::enable_if_t<detail::is_interval_key_v<K>>>
+      : std::is_convertible<T, detail::interval_point_t<K>> {};
+
+    using key_type = detail::hashed_key<K>;
+    using count_map_t = tbb::concurrent_unordered_map<key_type,
+                                                      detail::entry_count_ptr,
+                                                      detail::hashed_key_hash<K>,
+                                                      detail::hashed_key_equal<K>>;
     using count_value_type = typename count_map_t::value_type;
 
+    // The published entries are read without any locking; for a given
+    // key, the slot is never removed while the cache is in use.  An
+    // unpublished record is retired to the epoch domain, so that the
+    // value and the counter it refers to remain valid for any reader
+    // that may still observe it.
+    struct published_entry {
+      std::shared_ptr<V const> payload;
+      detail::concurrent_cache_entry<V>* entry;
+      detail::entry_count_ptr count;
+    };
+    struct published_value {
+      published_value() = default;
+      published_value(published_value const& other) : record{other.record.load()} {}
+      std::atomic<published_entry const*> record{nullptr};
+    };
+    using published_map_t = tbb::concurrent_unordered_map<key_type,
+                                                          published_value,
+                                                          detail::hashed_key_hash<K>,
+                                                          detail::hashed_key_equal<K>>;
+    using published_slot = std::atomic<published_entry const*>;
+
+    // For dense keys, the entries are published in a directly indexed
+    // table, through which all lookups are made (see dense_table.h).
+    static constexpr bool dense = is_dense_key_v<K>;
+    using publication_t =
+      std::conditional_t<dense, detail::dense_table<published_entry>, published_map_t>;
+
   public:
     using Hasher = tbb::tbb_hash_compare<K>;
-    using collection_t = tbb::concurrent_hash_map<K, detail::concurrent_cache_entry<V>, Hasher>;
-    using mapped_type = typename collection_t::mapped_type;
+    using mapped_type = detail::concurrent_cache_entry<V>;
+    // The entries are allocated separately from the map's nodes, so that
+    // an entry can outlive its node (see vacate_superseded_).
+    using collection_t = tbb::concurrent_hash_map<key_type,
+                                                  std::unique_ptr<mapped_type>,
+                                                  detail::hashed_key_compare<K>>;
     using value_type = typename collection_t::value_type;
     using accessor = typename collection_t::accessor;
+    using const_accessor = typename collection_t::const_accessor;
     using handle = cache_handle<V>;
 
     // TODO: Provide boundedness feature ?
 
+    concurrent_cache() : concurrent_cache{cache_option::none} {}
+    explicit concurrent_cache(cache_option const options) : options_{options}
+    {
+      if (any(options_, cache_option::compress_retained) and not detail::has_cache_codec_v<V>) {
+        throw cet::exception("Cache configuration error.")
+          << "Compression of retained entries was requested, but no cet::cache_codec\n"
+          << "specialization is available for the cache's value type.";
+      }
+      if (any(options_, cache_option::deduplicate_values) and not detail::is_deduplicable_v<V>) {
+        throw cet::exception("Cache configuration error.")
+          << "Value deduplication was requested, but the cache's value type does not\n"
+          << "provide both a cet::cache_value_hash specialization and operator==.";
+      }
+      if (any(options_, cache_option::coalesce_intervals) and not coalescable) {
+        throw cet::exception("Cache configuration error.")
+          << "Coalescing of intervals was requested, but the cache's key type is not an\n"
+          << "interval key, or its value type does not provide operator==.";
+      }
+      auto const overlap_options = cache_option::reject_overlaps | cache_option::newest_wins;
+      if (any(options_, overlap_options) and not detail::is_interval_key_v<K>) {
+        throw cet::exception("Cache configuration error.")
+          << "An overlap policy was requested, but the cache's key type is not an interval key.";
+      }
+      if (any(options_, cache_option::reject_overlaps) and
+          any(options_, cache_option::newest_wins)) {
+        throw cet::exception("Cache configuration error.")
+          << "Only one overlap policy may be specified.";
+      }
+      if (dense or
+          any(options_, cache_option::epoch_protection | cache_option::optimistic_reads)) {
+        if (any(options_, cache_option::compress_retained)) {
+          throw cet::exception("Cache configuration error.")
+            << "Dense keys, epoch protection and optimistic reads cannot be combined with\n"
+            << "the compression of retained entries.";
+        }
+        epochs_ = std::make_unique<detail::epoch_domain>();
+      }
+    }
+
+    template <typename FwdIt,
+              typename = typename std::iterator_traits<FwdIt>::iterator_category>
+    concurrent_cache(FwdIt const first,
+                     FwdIt const last,
+                     cache_option const options = cache_option::none)
+      : concurrent_cache{options}
+    {
+      emplace_bulk_(first, last);
+    }
+
+    ~concurrent_cache()
+    {
+      if (governor_) {
+        governor_->leave_(*membership_);
+      }
+      if constexpr (dense) {
+        published_.for_each([](published_slot& slot) { delete slot.load(); });
+      }
+      else {
+        for (auto& pr : published_) {
+          delete pr.second.record.load();
+        }
+      }
+    }
+
     size_t
     size() const
     {
@@ -158,56 +573,293 @@ namespace cet {
       return std::size(counts_);
     }
 
+    // Sizes the cache's maps for n entries, so that emplacing up to n
+    // entries does not rehash them.  Must not be called concurrently
+    // with any other member function; memory is not reclaimed from
+    // the cache by its governor meanwhile (see memory_governor.h).
+    void
+    reserve(std::size_t const n)
+    {
+      CET_ASSERT_ONLY_ONE_THREAD();
+      auto const suspended = suspend_reclaiming_();
+      entries_.rehash(n);
+      counts_.rehash(buckets_for_(counts_, n));
+      if constexpr (not dense) {
+        if (epochs_) {
+          published_.rehash(buckets_for_(published_, n));
+        }
+      }
+    }
+
+    // Estimated memory of all entries, in bytes (see memory_governor.h)
+    std::size_t
+    memory_usage() const noexcept
+    {
+      return bytes_.load();
+    }
+
+    // Subjects the cache to the governor's memory budget, reclaiming
+    // memory if the budget is already exceeded.  Must not be called
+    // concurrently with any other member function.
+    void
+    join(memory_governor& governor, double const weight = 1.)
+    {
+      CET_ASSERT_ONLY_ONE_THREAD();
+      if (governor_) {
+        throw cet::exception("Cache configuration error.")
+          << "The cache has already joined a memory governor.";
+      }
+      auto member = std::make_unique<membership>(*this);
+      governor.join_(*member, weight);
+      membership_ = std::move(member);
+      governor_ = &governor;
+      release_signal_.flag = &governor.released_;
+      governor.enforce();
+    }
+
     template <typename U = V>
     handle
     emplace(K const& k, U&& value)
     {
-      // Lock held on k's map entry until the function returns.
-      accessor access_token;
-      if (not entries_.insert(access_token, k)) {
-        // Entry already exists; return cached entry.
-        return handle{access_token->second};
-      }
+      return enforce_budget_(emplace_key_(k, std::forward<U>(value)));
+    }
 
-      auto const sequence_number = next_sequence_number_.fetch_add(1);
-      auto counter = detail::make_counter(sequence_number);
-      access_token->second = mapped_type{std::forward<U>(value), counter};
+    template <typename U = V>
+    handle
+    emplace(K&& k, U&& value)
+    {
+      return enforce_budget_(emplace_key_(std::move(k), std::forward<U>(value)));
+    }
 
-      auto [it, inserted] = counts_.insert(count_value_type{k, counter});
-      if (not inserted) {
-        it->second = counter;
-      }
-      return handle{access_token->second};
+    // Unlike emplace(...), the value is constructed in place from
+    // 'args' only if no entry exists yet for k.  The value is
+    // constructed while holding the lock on k's entry, so that it is
+    // never constructed and then discarded; other lookups of k wait
+    // for the construction to complete.
+    template <typename... Args>
+    handle
+    try_emplace(K const& k, Args&&... args)
+    {
+      return enforce_budget_(try_emplace_(k, std::forward<Args>(args)...));
+    }
+
+    template <typename... Args>
+    handle
+    try_emplace(K&& k, Args&&... args)
+    {
+      return enforce_budget_(try_emplace_(std::move(k), std::forward<Args>(args)...));
     }
 
     template <typename T>
     std::enable_if_t<key_supports<T>::value, handle>
     entry_for(T const& t) const
     {
-      std::vector<K> matching_keys;
-      for (auto const& [key, count] : counts_) {
-        if (key.supports(t)) {
-          matching_keys.push_back(key);
-        }
+      if (auto const key = key_for_(t)) {
+        return at(*key);
       }
+      return handle{};
+    }
 
-      if (std::empty(matching_keys)) {
-        return handle{};
+    template <typename T>
+    std::enable_if_t<key_supports<T>::value, cache_view<V>>
+    entry_for(T const& t, pinned_set<V>& pins) const
+    {
+      if (auto const key = key_for_(t)) {
+        return at(*key, pins);
       }
+      return cache_view<V>{};
+    }
+
+    // Non-blocking and timed variants
+    //
+    // The following functions return std::nullopt if the entry for k
+    // is busy--i.e. if it is being emplaced, dropped or compressed by
+    // another thread--instead of waiting for it.  Otherwise, they
+    // return the same handle as at(k) or emplace(k, value).  Writers
+    // announce themselves on one of a fixed number of per-cache
+    // stripes, so an entry may also be reported busy because an entry
+    // with a different key, sharing the same stripe, is being
+    // modified.  Readers are reported busy because of other readers
+    // only while another reader restores a compressed entry.  The
+    // non-blocking readers announce themselves on the stripe as well,
+    // and a writer that arrives during such a read does not lock the
+    // entry before the read is complete, so the read itself never
+    // waits for a writer.  The at_for(...) function sleeps until the
+    // writers are done or the timeout expires; timeouts that exceed
+    // the range of the steady clock (e.g. duration::max()) never
+    // expire.  For caches with interval options (see above),
+    // emplace_nowait(...) also reports busy if any other interval is
+    // being emplaced.
+    std::optional<handle>
+    try_at(K const& k) const
+    {
+      return try_at_(probe_(k));
+    }
 
-      if (std::size(matching_keys) > 1) {
-        throw cet::exception("Data retrieval error.") << "More than one key match.";
+    template <typename Rep, typename Period>
+    std::optional<handle>
+    at_for(K const& k, std::chrono::duration<Rep, Period> const& timeout) const
+    {
+      auto const deadline = deadline_after_(timeout);
+      auto const probe = probe_(k);
+      while (true) {
+        if (auto h = try_at_(probe)) {
+          return h;
+        }
+        if (not await_writers_(probe, deadline)) {
+          return std::nullopt;
+        }
       }
+    }
 
-      return at(matching_keys[0]);
+    template <typename U = V>
+    std::optional<handle>
+    emplace_nowait(K const& k, U&& value)
+    {
+      if constexpr (detail::is_interval_key_v<K>) {
+        if (any(options_, interval_options)) {
+          std::unique_lock lock{interval_mutex_, std::try_to_lock};
+          if (not lock) {
+            return std::nullopt;
+          }
+          return emplace_interval_(k, V(std::forward<U>(value)), std::move(lock));
+        }
+      }
+      auto const probe = probe_(k);
+      if (busy_(probe)) {
+        return std::nullopt;
+      }
+      writer_guard const writing{*this, probe};
+      return emplace_locked_(k, probe, std::forward<U>(value));
     }
 
     handle
     at(K const& k) const
     {
-      if (accessor access_token; entries_.find(access_token, k))
-        return handle{access_token->second};
-      return handle{};
+      return at_(probe_(k));
+    }
+
+    // Lookup without hashing (see hashed_key.h)
+    handle
+    at(prehashed_key<K> const& k) const
+    {
+      return at_(probe_(k));
+    }
+
+    // Heterogeneous lookup for string keys (see hashed_key.h)
+    template <typename T>
+    std::enable_if_t<detail::is_heterogeneous_key_v<K, T>, handle>
+    at(T const& t) const
+    {
+      return at_(key_type::borrow(t));
+    }
+
+    cache_view<V>
+    at(K const& k, pinned_set<V>& pins) const
+    {
+      if (const_accessor access_token; entries_.find(access_token, probe_(k)))
+        return pins.pin_(*access_token->second);
+      return cache_view<V>{};
+    }
+
+    // Epoch-protected reads (see above)
+    epoch_guard
+    read_guard() const
+    {
+      if (not any(options_, cache_option::epoch_protection)) {
+        throw cet::exception("Cache configuration error.")
+          << "Epoch-protected reads require the cache_option::epoch_protection option.";
+      }
+      if (auto guard = epochs_->try_enter()) {
+        return std::move(*guard);
+      }
+      throw cet::exception("Data retrieval error.")
+        << "All " << detail::epoch_domain::max_readers
+        << " read guards of the cache are in use.";
+    }
+
+    cache_view<V>
+    at(K const& k, epoch_guard const& guard) const
+    {
+      if (guard.domain() == nullptr or guard.domain() != epochs_.get()) {
+        throw cet::exception("Data retrieval error.")
+          << "The epoch guard was not created by this cache.";
+      }
+      auto const* slot = find_published_(probe_(k));
+      if (slot == nullptr) {
+        return cache_view<V>{};
+      }
+      auto const* record = slot->load();
+      return record ? cache_view<V>{*record->payload} : cache_view<V>{};
+    }
+
+    template <typename T>
+    std::enable_if_t<key_supports<T>::value, cache_view<V>>
+    entry_for(T const& t, epoch_guard const& guard) const
+    {
+      if (auto const key = key_for_(t)) {
+        return at(*key, guard);
+      }
+      return cache_view<V>{};
+    }
+
+    // Batch lookups
+    //
+    // For each value in 'values', a pointer to the value of the entry
+    // that supports it (or nullptr, if no entry does) is written to
+    // 'out'.  The returned handles keep all referred-to entries pinned;
+    // each distinct entry is pinned once, irrespective of the order of
+    // the values.  Sorted values are resolved by a forward sweep through
+    // the interval index.
+    template <typename Values, typename OutputIt>
+    std::enable_if_t<indexed_by<typename Values::value_type>::value, std::vector<handle>>
+    entry_for_many(Values const& values, OutputIt out) const
+    {
+      std::vector<handle> pins;
+      std::unordered_set<mapped_type const*> pinned;
+      detail::index_hint hint;
+      std::optional<K> key;
+      V const* current{nullptr};
+      for (detail::interval_point_t<K> const p : values) {
+        if (key and key->supports(p)) {
+          *out++ = current;
+          continue;
+        }
+
+        auto const n = index_.find(p, key, hint);
+        if (n > 1u) {
+          throw cet::exception("Data retrieval error.") << "More than one key match.";
+        }
+        current = nullptr;
+        if (n == 0u) {
+          key.reset();
+        }
+        else {
+          current = pin_once_(at(*key), pins, pinned);
+        }
+        *out++ = current;
+      }
+      return pins;
+    }
+
+    // As above, but for each key in 'keys'.  Consecutive equal keys
+    // are looked up only once.
+    template <typename Keys, typename OutputIt>
+    std::vector<handle>
+    at_many(Keys const& keys, OutputIt out) const
+    {
+      std::vector<handle> pins;
+      std::unordered_set<mapped_type const*> pinned;
+      std::optional<K> previous_key;
+      V const* current{nullptr};
+      for (K const& k : keys) {
+        if (not previous_key or not(*previous_key == k)) {
+          current = pin_once_(at(k), pins, pinned);
+          previous_key = k;
+        }
+        *out++ = current;
+      }
+      return pins;
     }
 
     void
@@ -219,70 +871,977 @@ namespace cet {
     void
     drop_unused_but_last(std::size_t const keep_last)
     {
+      if (epochs_) {
+        epochs_->reclaim();
+      }
+
+      drop_detached_();
       auto entries_to_drop = unused_entries_();
       std::sort(begin(entries_to_drop), end(entries_to_drop), std::greater<>{});
 
-      if (std::size(entries_to_drop) <= keep_last) {
+      // Superseded entries are never retained.
+      auto const retained_end = std::stable_partition(
+        begin(entries_to_drop), end(entries_to_drop), [this](auto const& entry) {
+          return not superseded_(entry.second);
+        });
+      auto const n_retained =
+        std::min(keep_last, static_cast<std::size_t>(retained_end - begin(entries_to_drop)));
+
+      if (any(options_, cache_option::compress_retained)) {
+        compress_(cbegin(entries_to_drop), cbegin(entries_to_drop) + n_retained);
+      }
+
+      if (std::size(entries_to_drop) <= n_retained) {
         return;
       }
 
-      auto const erase_begin = cbegin(entries_to_drop) + keep_last;
+      auto const erase_begin = cbegin(entries_to_drop) + n_retained;
       auto const erase_end = cend(entries_to_drop);
       for (auto it = erase_begin; it != erase_end; ++it) {
-        // We need to protect access to the element that is about to
-        // be erased (via entries_.find(...))--if we don't, then the
-        // reference count can be incremented during an insert and we
-        // end up erasing the element, creating invalid handles.
-        accessor access_token;
-        if (not entries_.find(access_token, it->second)) {
+        erase_unused_(it->second);
+      }
+      if (epochs_) {
+        epochs_->reclaim();
+      }
+    }
+
+    // As for reserve(n), memory is not reclaimed from the cache by its
+    // governor meanwhile.
+    void
+    shrink_to_fit()
+    {
+      CET_ASSERT_ONLY_ONE_THREAD();
+      auto const suspended = suspend_reclaiming_();
+      drop_unused();
+      std::vector<std::pair<key_type, detail::entry_count_ptr>> live_entries;
+      std::copy_if(
+        begin(counts_), end(counts_), std::back_inserter(live_entries), [](auto const& pr) {
+          return pr.second->use_count != detail::entry_count::erased;
+        });
+      counts_ = count_map_t{begin(live_entries), end(live_entries)};
+      if constexpr (not dense) {
+        if (epochs_) {
+          std::vector<std::pair<key_type, published_value>> published;
+          std::copy_if(begin(published_),
+                       end(published_),
+                       std::back_inserter(published),
+                       [](auto const& pr) { return pr.second.record != nullptr; });
+          published_ = published_map_t{begin(published), end(published)};
+        }
+      }
+      values_.prune();
+    }
+
+  private:
+    template <typename T>
+    std::optional<K>
+    key_for_(T const& t) const
+    {
+      if constexpr (indexed_by<T>::value) {
+        std::optional<K> key;
+        auto const n = index_.find(t, key);
+        if (n > 1u) {
+          throw cet::exception("Data retrieval error.") << "More than one key match.";
+        }
+        return key;
+      }
+      else {
+        std::vector<K> matching_keys;
+        for (auto const& [hashed, count] : counts_) {
+          if (count->superseded) {
+            continue;
+          }
+          if (auto const& key = hashed.key(); key.supports(t)) {
+            matching_keys.push_back(key);
+          }
+        }
+
+        if (std::empty(matching_keys)) {
+          return std::nullopt;
+        }
+
+        if (std::size(matching_keys) > 1) {
+          throw cet::exception("Data retrieval error.") << "More than one key match.";
+        }
+
+        return matching_keys[0];
+      }
+    }
+
+    // Returns the value referred to by h, and adds h to 'pins' unless
+    // its entry is already pinned there.
+    static V const*
+    pin_once_(handle h,
+              std::vector<handle>& pins,
+              std::unordered_set<mapped_type const*>& pinned)
+    {
+      if (not h) {
+        return nullptr;
+      }
+      V const* value = &*h;
+      if (pinned.insert(h.entry_.get()).second) {
+        pins.push_back(std::move(h));
+      }
+      return value;
+    }
+
+    template <typename KK, typename U>
+    handle
+    emplace_key_(KK&& k, U&& value)
+    {
+      if constexpr (detail::is_interval_key_v<K>) {
+        if (any(options_, interval_options)) {
+          std::unique_lock lock{interval_mutex_};
+          return emplace_interval_(k, V(std::forward<U>(value)), std::move(lock));
+        }
+      }
+      return emplace_(std::forward<KK>(k), std::forward<U>(value));
+    }
+
+    template <typename KK, typename... Args>
+    handle
+    try_emplace_(KK&& k, Args&&... args)
+    {
+      if constexpr (detail::is_interval_key_v<K>) {
+        if (any(options_, interval_options)) {
+          std::unique_lock lock{interval_mutex_};
+          if (auto h = current_entry_(k)) {
+            return h;
+          }
+          return emplace_interval_(k, V(std::forward<Args>(args)...), std::move(lock));
+        }
+      }
+      auto const probe = probe_(k);
+      if (auto h = at_(probe)) {
+        return h;
+      }
+      writer_guard const writing{*this, probe};
+      return emplace_constructed_(std::forward<KK>(k), probe, [this, &args...] {
+        return make_payload_(std::forward<Args>(args)...);
+      });
+    }
+
+    template <typename KK, typename U>
+    handle
+    emplace_(KK&& k, U&& value)
+    {
+      auto const probe = probe_(k);
+      writer_guard const writing{*this, probe};
+      return emplace_locked_(std::forward<KK>(k), probe, std::forward<U>(value));
+    }
+
+    // Must be called while announced on k's stripe.
+    template <typename KK, typename U>
+    handle
+    emplace_locked_(KK&& k,
+                    key_type const& probe,
+                    U&& value,
+                    std::optional<std::size_t> const sequence_number = std::nullopt)
+    {
+      return emplace_constructed_(
+        std::forward<KK>(k),
+        probe,
+        [&value]() -> U&& { return std::forward<U>(value); },
+        sequence_number);
+    }
+
+    // Must be called while announced on k's stripe.  The value is
+    // obtained from 'make_value' only if no entry exists yet for k.
+    // Unless a sequence number is provided (see emplace_bulk_), the
+    // next one is drawn.
+    template <typename KK, typename F>
+    handle
+    emplace_constructed_(KK&& k,
+                         key_type const& probe,
+                         F&& make_value,
+                         std::optional<std::size_t> const sequence_number = std::nullopt)
+    {
+      if constexpr (dense) {
+        // Checked before anything is inserted, so that a failure leaves
+        // no trace in the cache.
+        if (static_cast<std::size_t>(*probe.view()) >= publication_t::capacity) {
+          throw cet::exception("Cache insertion error.")
+            << "The dense key is negative or not smaller than " << publication_t::capacity
+            << ".";
+        }
+      }
+
+      // Lock held on k's map entry until the function returns.
+      accessor access_token;
+      if (not entries_.insert(access_token, probe)) {
+        // Entry already exists; return cached entry.
+        return handle{*access_token->second};
+      }
+
+      auto counter = detail::make_counter(sequence_number ? *sequence_number :
+                                                            next_sequence_number_.fetch_add(1));
+      counter->on_release = &release_signal_;
+      try {
+        access_token->second = std::make_unique<mapped_type>(make_entry_(make_value(), counter));
+        counter->bytes = entry_overhead + cache_value_size<V>{}(access_token->second->get());
+        charge_(counter->bytes);
+
+        if constexpr (detail::is_interval_key_v<K>) {
+          // The index is updated while the accessor is held so that
+          // index updates for a given key are never reordered.
+          index_.insert(k);
+        }
+        // The key is moved, if possible, into its last destination.
+        auto [it, inserted] =
+          counts_.insert(count_value_type{key_type{std::forward<KK>(k), probe.hash()}, counter});
+        if (not inserted) {
+          it->second = counter;
+        }
+        // Published last, so that no reader can observe an entry whose
+        // emplacement fails.
+        if (epochs_) {
+          publish_(access_token->first, *access_token->second);
+        }
+      }
+      catch (...) {
+        discard_(access_token, *counter);
+        throw;
+      }
+      return handle{*access_token->second};
+    }
+
+    // Undoes a failed emplacement, so that the key can be emplaced
+    // again.  Must be called while holding the entry's accessor.
+    void
+    discard_(accessor& access_token, detail::entry_count& counter)
+    {
+      counter.use_count = detail::entry_count::erased;
+      if constexpr (detail::is_interval_key_v<K>) {
+        index_.erase(access_token->first.key());
+      }
+      credit_(counter.bytes);
+      entries_.erase(access_token);
+    }
+
+    template <typename FwdIt>
+    void
+    emplace_bulk_(FwdIt const first, FwdIt const last)
+    {
+      if constexpr (detail::is_interval_key_v<K>) {
+        if (any(options_, interval_options)) {
+          // Emplacing is serialized in these modes.
+          for (auto it = first; it != last; ++it) {
+            emplace(it->first, it->second);
+          }
+          return;
+        }
+      }
+
+      std::size_t const n = std::distance(first, last);
+      reserve(n);
+      auto emplace_block = [this](FwdIt it, FwdIt const end, std::size_t const size) {
+        // The sequence numbers of the whole block are drawn at once.
+        auto sequence_number = next_sequence_number_.fetch_add(size);
+        for (; it != end; ++it, ++sequence_number) {
+          auto const& [k, value] = *it;
+          auto const probe = probe_(k);
+          writer_guard const writing{*this, probe};
+          emplace_locked_(k, probe, value, sequence_number);
+        }
+      };
+
+      using category = typename std::iterator_traits<FwdIt>::iterator_category;
+      if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+        tbb::parallel_for(tbb::blocked_range<std::size_t>{0, n}, [&](auto const& r) {
+          emplace_block(first + r.begin(), first + r.end(), r.size());
+        });
+      }
+      else {
+        emplace_block(first, last, n);
+      }
+    }
+
+    template <typename Map>
+    static std::size_t
+    buckets_for_(Map const& map, std::size_t const n)
+    {
+      return static_cast<std::size_t>(n / map.max_load_factor()) + 1;
+    }
+
+    // The lock must be held on the interval mutex.
+    handle
+    emplace_interval_(K const& k, V&& value, std::unique_lock<std::mutex>)
+    {
+      if (auto h = current_entry_(k)) {
+        return h;
+      }
+      if constexpr (coalescable) {
+        if (any(options_, cache_option::coalesce_intervals)) {
+          // E.g. an interval that has been merged into a larger one
+          if (auto h = covering_entry_(k, value)) {
+            return h;
+          }
+        }
+      }
+
+      // A superseded entry for k is replaced by the new value.
+      vacate_superseded_(k);
+      resolve_overlaps_(k);
+      if constexpr (coalescable) {
+        if (any(options_, cache_option::coalesce_intervals)) {
+          return coalesce_(k, std::move(value));
+        }
+      }
+      return emplace_(k, std::move(value));
+    }
+
+    void
+    resolve_overlaps_(K const& k)
+    {
+      auto const overlapping_keys = index_.overlapping(k);
+      if (std::empty(overlapping_keys)) {
+        return;
+      }
+
+      if (any(options_, cache_option::reject_overlaps)) {
+        throw cet::exception("Cache insertion error.")
+          << "The emplaced key overlaps with " << std::size(overlapping_keys)
+          << " existing key(s).";
+      }
+
+      if (not any(options_, cache_option::newest_wins)) {
+        return;
+      }
+
+      for (auto const& key : overlapping_keys) {
+        auto payload = payload_(key);
+        supersede_(key);
+        if (payload == nullptr) {
+          // Entry dropped in the meantime
           continue;
         }
+        if (key.begin() < k.begin()) {
+          emplace_shared_(K{key.begin(), k.begin()}, payload);
+        }
+        if (k.end() < key.end()) {
+          emplace_shared_(K{k.end(), key.end()}, payload);
+        }
+      }
+    }
+
+    // The neighbors of k are found through the interval index, which
+    // holds no superseded keys.
+    handle
+    coalesce_(K const& k, V&& value)
+    {
+      auto const [left_keys, right_keys] = index_.adjacent(k);
+      std::shared_ptr<V const> payload;
+      auto merge_with = [this, &value, &payload](std::vector<K> const& candidates) {
+        for (auto const& key : candidates) {
+          auto neighbor = payload_(key);
+          if (neighbor == nullptr or not(*neighbor == value)) {
+            continue;
+          }
+          if (payload == nullptr) {
+            payload = std::move(neighbor);
+          }
+          return std::optional<K>{key};
+        }
+        return std::optional<K>{};
+      };
+
+      auto begin = k.begin();
+      auto end = k.end();
+      std::vector<K> merged_keys;
+      if (auto const left = merge_with(left_keys)) {
+        begin = left->begin();
+        merged_keys.push_back(*left);
+      }
+      if (auto const right = merge_with(right_keys)) {
+        end = right->end();
+        merged_keys.push_back(*right);
+      }
+
+      if (std::empty(merged_keys)) {
+        return emplace_(k, std::move(value));
+      }
+
+      for (auto const& key : merged_keys) {
+        supersede_(key);
+      }
+      return emplace_shared_(K{begin, end}, std::move(payload));
+    }
 
-        // It's possible the reference count to the element was
-        // increased between the unused_entries_() call and the
-        // entries_.find(...) call made directly above.  We therefore
-        // check that the reference count is actually zero before
-        // erasing the element.
-        if (access_token->second.reference_count() != 0u) {
+    // Returns a handle to the entry whose interval covers k, provided
+    // its value compares equal to 'value'.
+    handle
+    covering_entry_(K const& k, V const& value) const
+    {
+      for (auto const& key : index_.overlapping(k)) {
+        if (k.begin() < key.begin() or key.end() < k.end()) {
           continue;
         }
+        if (auto h = at(key); h and *h == value) {
+          return h;
+        }
+      }
+      return handle{};
+    }
+
+    // Returns the payload of k's entry, if it exists, restoring it if
+    // it is compressed.
+    std::shared_ptr<V const>
+    payload_(K const& k)
+    {
+      const_accessor access_token;
+      if (not entries_.find(access_token, probe_(k))) {
+        return nullptr;
+      }
+      handle const pin{*access_token->second};
+      return access_token->second->payload();
+    }
 
-        entries_.erase(access_token);
+    // Returns a handle to k's entry, unless it does not exist or it has
+    // been superseded.
+    handle
+    current_entry_(K const& k) const
+    {
+      if (superseded_(k)) {
+        return handle{};
       }
+      return at(k);
     }
 
+    // Removes k's entry from the cache if it has been superseded,
+    // unless it already refers to 'payload'.  A superseded entry that
+    // is still in use is detached instead: its handles remain valid,
+    // and it is destroyed by the drop_unused* functions once unused.
     void
-    shrink_to_fit()
+    vacate_superseded_(K const& k, V const* payload = nullptr)
     {
-      CET_ASSERT_ONLY_ONE_THREAD();
-      drop_unused();
-      std::vector<count_value_type> all_key_entries(begin(counts_), end(counts_));
-      auto const stale_entries = unused_entries_();
-      for (auto const& [sequence_number, key] : stale_entries) {
-        auto it = std::find_if(begin(all_key_entries),
-                               end(all_key_entries),
-                               [&key](auto const& pr) { return pr.second == key; });
-        all_key_entries.erase(it);
+      if (not superseded_(k)) {
+        return;
+      }
+      auto const probe = probe_(k);
+      writer_guard const writing{*this, probe};
+      accessor access_token;
+      if (not entries_.find(access_token, probe)) {
+        return;
+      }
+      auto& entry = access_token->second;
+      if (payload != nullptr and entry->payload().get() == payload) {
+        return;
+      }
+      if (epochs_) {
+        unpublish_(probe);
       }
-      counts_ = count_map_t{begin(all_key_entries), end(all_key_entries)};
+      if (entry->try_mark_erased()) {
+        credit_(entry->counter()->bytes);
+      }
+      else {
+        std::lock_guard lock{detached_mutex_};
+        detached_.push_back(std::move(entry));
+      }
+      entries_.erase(access_token);
     }
 
-  private:
+    // Destroys the detached entries that are no longer in use.
+    // Returns the estimated memory reclaimed.
+    std::size_t
+    drop_detached_()
+    {
+      std::lock_guard lock{detached_mutex_};
+      std::size_t reclaimed{};
+      auto const e = std::remove_if(begin(detached_), end(detached_), [&reclaimed](auto& entry) {
+        if (not entry->try_mark_erased()) {
+          return false;
+        }
+        reclaimed += entry->counter()->bytes;
+        return true;
+      });
+      detached_.erase(e, end(detached_));
+      credit_(reclaimed);
+      return reclaimed;
+    }
+
+    // Emplaces an interval that shares the payload of other entries.
+    // The interval may correspond to a superseded entry, which is then
+    // reinstated if it refers to the same payload, and replaced
+    // otherwise.
+    handle
+    emplace_shared_(K const& k, std::shared_ptr<V const> payload)
+    {
+      vacate_superseded_(k, payload.get());
+      auto h = emplace_(k, std::move(payload));
+      if (auto it = counts_.find(probe_(k)); it != counts_.end()) {
+        it->second->superseded = false;
+      }
+      index_.insert(k);
+      return h;
+    }
+
+    void
+    supersede_(K const& k)
+    {
+      if (auto it = counts_.find(probe_(k)); it != counts_.end()) {
+        it->second->superseded = true;
+      }
+      index_.erase(k);
+    }
+
+    bool
+    superseded_(K const& k) const
+    {
+      if constexpr (detail::is_interval_key_v<K>) {
+        if (auto it = counts_.find(probe_(k)); it != counts_.end()) {
+          return it->second->superseded;
+        }
+      }
+      return false;
+    }
+
+    template <typename... Args>
+    std::shared_ptr<V const>
+    make_payload_(Args&&... args)
+    {
+      if constexpr (detail::is_deduplicable_v<V>) {
+        if (any(options_, cache_option::deduplicate_values)) {
+          return values_.intern(V(std::forward<Args>(args)...));
+        }
+      }
+      return std::make_shared<V const>(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    mapped_type
+    make_entry_(U&& value, detail::entry_count_ptr counter)
+    {
+      if constexpr (std::is_same_v<std::decay_t<U>, std::shared_ptr<V const>>) {
+        // The payload has already been created, or it is shared with
+        // another entry.
+        return mapped_type{std::forward<U>(value), std::move(counter)};
+      }
+      else {
+        if constexpr (detail::is_deduplicable_v<V>) {
+          if (any(options_, cache_option::deduplicate_values)) {
+            return mapped_type{values_.intern(std::forward<U>(value)), std::move(counter)};
+          }
+        }
+        return mapped_type{std::forward<U>(value), std::move(counter)};
+      }
+    }
+
+    template <typename FwdIt>
+    void
+    compress_(FwdIt it, FwdIt const end)
+    {
+      for (; it != end; ++it) {
+        // As for dropping, the accessor guarantees that no handle can
+        // be created for the entry while it is being compressed.
+        auto const probe = probe_(it->second);
+        writer_guard const writing{*this, probe};
+        accessor access_token;
+        if (not entries_.find(access_token, probe)) {
+          continue;
+        }
+        access_token->second->compress();
+      }
+    }
+
+    // Must be called while holding an accessor to the entry.
+    void
+    publish_(key_type const& k, mapped_type& entry)
+    {
+      auto const* record = new published_entry{entry.payload(), &entry, entry.counter()};
+      if (auto const* old = published_slot_(k).exchange(record)) {
+        epochs_->retire(std::shared_ptr<published_entry const>{old});
+      }
+    }
+
+    // Unpublishes the entry for k, whose value is destroyed once no
+    // epoch guard can observe it.  Must be called while holding an
+    // accessor to the entry.
+    void
+    unpublish_(key_type const& k)
+    {
+      auto* slot = find_published_(k);
+      if (slot == nullptr) {
+        return;
+      }
+      if (auto const* old = slot->exchange(nullptr)) {
+        epochs_->retire(std::shared_ptr<published_entry const>{old});
+      }
+    }
+
+    // Looks up and pins the entry for k without locking.  The record
+    // that is read serves as the version stamp: if its entry has been
+    // marked as erased, a concurrent drop is in progress, and the
+    // lookup is retried with the record that replaces it.  Returns
+    // std::nullopt if the lookup should instead be made by the locking
+    // path (i.e. if no entry has been published for a non-dense key k,
+    // if all epoch slots are taken, or if the retries are exhausted).
+    std::optional<handle>
+    optimistic_at_(key_type const& k) const
+    {
+      auto const* slot = find_published_(k);
+      if (slot == nullptr) {
+        return dense ? std::optional{handle{}} : std::nullopt;
+      }
+      auto const guard = epochs_->try_enter();
+      if (not guard) {
+        return std::nullopt;
+      }
+      for (unsigned attempt{}; attempt != max_optimistic_attempts; ++attempt) {
+        auto const* record = slot->load();
+        if (record == nullptr) {
+          return handle{};
+        }
+        if (mapped_type::try_acquire(*record->count, *record->entry)) {
+          return handle{*record->entry, typename handle::adopt_reference_t{}};
+        }
+        std::this_thread::yield();
+      }
+      return std::nullopt;
+    }
+
+    published_slot const*
+    find_published_(key_type const& k) const
+    {
+      if constexpr (dense) {
+        return published_.find(static_cast<std::size_t>(*k.view()));
+      }
+      else {
+        auto it = published_.find(k);
+        return it == published_.end() ? nullptr : &it->second.record;
+      }
+    }
+
+    published_slot*
+    find_published_(key_type const& k)
+    {
+      return const_cast<published_slot*>(std::as_const(*this).find_published_(k));
+    }
+
+    published_slot&
+    published_slot_(key_type const& k)
+    {
+      if constexpr (dense) {
+        return published_.slot(static_cast<std::size_t>(*k.view()));
+      }
+      else {
+        return published_.insert({k, published_value{}}).first->second.record;
+      }
+    }
+
+    // Writers (i.e. emplacing, dropping and compressing) announce
+    // themselves on the stripe of the affected key before acquiring
+    // its accessor.  The stripes do not exclude writers from each
+    // other; they only let the non-blocking functions detect them.
+    // Conversely, a writer does not acquire its accessor while a
+    // non-blocking read is in progress on its stripe.
+    struct alignas(64) writer_stripe {
+      std::atomic<unsigned> writers{};
+      std::atomic<unsigned> readers{};
+    };
+
+    class writer_guard {
+    public:
+      writer_guard(concurrent_cache const& cache, key_type const& k) noexcept
+        : cache_{cache}, stripe_{cache.stripe_for_(k)}
+      {
+        ++stripe_.writers;
+        while (stripe_.readers.load() != 0u) {
+          std::this_thread::yield();
+        }
+      }
+      ~writer_guard()
+      {
+        if (--stripe_.writers == 0u and cache_.waiters_.load() != 0u) {
+          std::lock_guard lock{cache_.waiters_mutex_};
+          cache_.writers_done_.notify_all();
+        }
+      }
+      writer_guard(writer_guard const&) = delete;
+      writer_guard& operator=(writer_guard const&) = delete;
+
+    private:
+      concurrent_cache const& cache_;
+      writer_stripe& stripe_;
+    };
+
+    class reader_guard {
+    public:
+      explicit reader_guard(writer_stripe& stripe) noexcept : stripe_{stripe}
+      {
+        ++stripe_.readers;
+      }
+      ~reader_guard() { --stripe_.readers; }
+      reader_guard(reader_guard const&) = delete;
+      reader_guard& operator=(reader_guard const&) = delete;
+
+    private:
+      writer_stripe& stripe_;
+    };
+
+    writer_stripe&
+    stripe_for_(key_type const& k) const
+    {
+      return stripes_[k.hash() % n_stripes];
+    }
+
+    bool
+    busy_(key_type const& k) const noexcept
+    {
+      return stripe_for_(k).writers.load() != 0u;
+    }
+
+    // Returns std::nullopt instead of waiting for a writer, or for
+    // another reader that is restoring the entry.  As the read is
+    // announced before the writers are checked, no writer can lock k's
+    // entry until the read is complete.
+    std::optional<handle>
+    try_at_(key_type const& probe) const
+    {
+      reader_guard const reading{stripe_for_(probe)};
+      if (busy_(probe)) {
+        return std::nullopt;
+      }
+      const_accessor access_token;
+      if (not entries_.find(access_token, probe)) {
+        return handle{};
+      }
+      auto& entry = *access_token->second;
+      switch (mapped_type::try_acquire_nowait(*entry.counter(), entry)) {
+      case mapped_type::acquisition::acquired:
+        return handle{entry, typename handle::adopt_reference_t{}};
+      case mapped_type::acquisition::erased: return handle{};
+      case mapped_type::acquisition::busy: break;
+      }
+      return std::nullopt;
+    }
+
+    // Sleeps until no writer is announced on k's stripe.  Returns false
+    // if the deadline has passed.
+    bool
+    await_writers_(key_type const& k, std::chrono::steady_clock::time_point const deadline) const
+    {
+      if (std::chrono::steady_clock::now() >= deadline) {
+        return false;
+      }
+      auto const& stripe = stripe_for_(k);
+      auto const idle = [&stripe] { return stripe.writers.load() == 0u; };
+      if (idle()) {
+        // The entry is being restored by another reader.
+        std::this_thread::yield();
+        return true;
+      }
+      std::unique_lock lock{waiters_mutex_};
+      ++waiters_;
+      bool done{true};
+      if (deadline == std::chrono::steady_clock::time_point::max()) {
+        writers_done_.wait(lock, idle);
+      }
+      else {
+        done = writers_done_.wait_until(lock, deadline, idle);
+      }
+      --waiters_;
+      return done;
+    }
+
+    template <typename Rep, typename Period>
+    static std::chrono::steady_clock::time_point
+    deadline_after_(std::chrono::duration<Rep, Period> const& timeout)
+    {
+      using clock = std::chrono::steady_clock;
+      auto const now = clock::now();
+      if (timeout <= timeout.zero()) {
+        return now;
+      }
+      if (std::chrono::duration<double>{timeout} >=
+          std::chrono::duration<double>{clock::time_point::max() - now}) {
+        return clock::time_point::max();
+      }
+      return now + std::chrono::ceil<clock::duration>(timeout);
+    }
+
+    // Borrowed keys for lookups; the referred-to key must outlive the
+    // probe.
+    static key_type
+    probe_(K const& k)
+    {
+      return key_type::borrow(detail::key_traits<K>::view(k));
+    }
+
+    static key_type
+    probe_(prehashed_key<K> const& k) noexcept
+    {
+      return key_type::borrow(detail::key_traits<K>::view(k.key()), k.hash());
+    }
+
+    handle
+    at_(key_type const& probe) const
+    {
+      if (dense or any(options_, cache_option::optimistic_reads)) {
+        if (auto h = optimistic_at_(probe)) {
+          return std::move(*h);
+        }
+      }
+      // Readers share the entry's lock; the reference count is atomic.
+      if (const_accessor access_token; entries_.find(access_token, probe))
+        return handle{*access_token->second};
+      return handle{};
+    }
+
+    // Returns the estimated memory of the erased entry, or zero if the
+    // entry does not exist or is in use.
+    std::size_t
+    erase_unused_(K const& k)
+    {
+      // We need to protect access to the element that is about to be
+      // erased (via entries_.find(...))--if we don't, then the
+      // reference count can be incremented during an insert and we end
+      // up erasing the element, creating invalid handles.
+      auto const probe = probe_(k);
+      writer_guard const writing{*this, probe};
+      accessor access_token;
+      if (not entries_.find(access_token, probe)) {
+        return 0;
+      }
+
+      // It's possible the reference count to the element was increased
+      // between the unused_entries_() call and the entries_.find(...)
+      // call made directly above.  The element is therefore erased only
+      // if it can be atomically marked as such, which also prevents
+      // weak handles from acquiring it.
+      if (not access_token->second->try_mark_erased()) {
+        return 0;
+      }
+
+      if constexpr (detail::is_interval_key_v<K>) {
+        index_.erase(k);
+      }
+      if (epochs_) {
+        unpublish_(probe);
+      }
+      auto const bytes = access_token->second->counter()->bytes;
+      entries_.erase(access_token);
+      credit_(bytes);
+      return bytes;
+    }
+
+    // Drops unused entries, oldest first, until at least 'bytes' have
+    // been reclaimed (see memory_governor.h).
+    std::size_t
+    reclaim_(std::size_t const bytes)
+    {
+      auto reclaimed = drop_detached_();
+      auto entries_to_drop = unused_entries_();
+      std::sort(begin(entries_to_drop), end(entries_to_drop));
+      for (auto it = cbegin(entries_to_drop); it != cend(entries_to_drop) and reclaimed < bytes;
+           ++it) {
+        reclaimed += erase_unused_(it->second);
+      }
+      if (epochs_) {
+        epochs_->reclaim();
+      }
+      return reclaimed;
+    }
+
+    // Keeps the governor from reclaiming memory from this cache while
+    // its maps are rehashed or replaced.
+    std::unique_lock<std::mutex>
+    suspend_reclaiming_()
+    {
+      if (governor_) {
+        return governor_->suspend_();
+      }
+      return {};
+    }
+
+    handle
+    enforce_budget_(handle h)
+    {
+      // Called without holding any lock, as the governor may reclaim
+      // memory from any governed cache, including this one.
+      if (governor_) {
+        governor_->enforce();
+      }
+      return h;
+    }
+
+    void
+    charge_(std::size_t const bytes) noexcept
+    {
+      bytes_ += bytes;
+      if (governor_) {
+        governor_->charge_(bytes);
+      }
+    }
+
+    void
+    credit_(std::size_t const bytes) noexcept
+    {
+      bytes_ -= bytes;
+      if (governor_) {
+        governor_->credit_(bytes);
+      }
+    }
+
+    struct membership : detail::governed_cache {
+      explicit membership(concurrent_cache& c) : cache{&c} {}
+      std::size_t
+      memory_usage() const override
+      {
+        return cache->memory_usage();
+      }
+      std::size_t
+      reclaim(std::size_t const bytes) override
+      {
+        return cache->reclaim_(bytes);
+      }
+      concurrent_cache* cache;
+    };
+
     std::vector<std::pair<std::size_t, K>>
     unused_entries_()
     {
       std::vector<std::pair<std::size_t, K>> result;
-      for (auto const& [key, count] : counts_) {
-        if (count->use_count == 0u) {
-          result.emplace_back(count->sequence_number, key);
+      for (auto const& [hashed, count] : counts_) {
+        if (count->unused()) {
+          result.emplace_back(count->sequence_number, hashed.key());
         }
       }
       return result;
     }
 
+    friend class iov_cursor<K, V>;
+    friend class pin_scope<K, V>;
+
+    static constexpr std::size_t n_stripes = 64;
+
+    cache_option options_{cache_option::none};
     std::atomic<std::size_t> next_sequence_number_{0ull};
     collection_t entries_;
     count_map_t counts_;
+    detail::value_pool<V> values_;
+    index_t index_;
+    std::mutex interval_mutex_;
+    mutable std::array<writer_stripe, n_stripes> stripes_;
+    mutable std::atomic<unsigned> waiters_{}; // Threads sleeping in at_for(...)
+    mutable std::mutex waiters_mutex_;
+    mutable std::condition_variable writers_done_;
+    static constexpr unsigned max_optimistic_attempts = 8;
+
+    publication_t published_;
+    std::unique_ptr<detail::epoch_domain> epochs_;
+
+    static constexpr std::size_t entry_overhead = sizeof(value_type) + sizeof(mapped_type) +
+                                                  sizeof(count_value_type) +
+                                                  sizeof(detail::entry_count);
+    std::atomic<std::size_t> bytes_{};
+    memory_governor* governor_{nullptr};
+    std::unique_ptr<membership> membership_;
+    detail::release_signal release_signal_;
+
+    // Superseded entries that were still in use when their keys were
+    // emplaced again (see vacate_superseded_)
+    std::mutex detached_mutex_;
+    std::vector<std::unique_ptr<mapped_type>> detached_;
   };
 }
 
@@ -6,19 +6,78 @@
 // is used as the value_type of the concurrent_cache.  For more
 // details, see notes in concurrent_cache.h
 //
+// Besides the number of references to the entry, the entry's use
+// count can assume one of three special values:
+//
+//   - erased: the entry has been (or is about to be) erased from the
+//             cache, and it can no longer be referenced.
+//   - compressed: the entry's value is stored in compressed form.
+//   - busy: the entry's value is being compressed or restored.
+//
+// All transitions between these states are atomic, so that a
+// reference to an entry can be acquired without holding a lock on the
+// entry, provided that the entry's memory is known to be valid (see
+// weak_cache_handle.h).  Acquiring a reference to a compressed entry
+// restores its value.
+//
 // N.B. This is not intended to be user-facing.
 // ===================================================================
 
+#include "cetlib/cache_codec.h"
+#include "cetlib/cache_value_size.h"
 #include "cetlib_except/exception.h"
 
 #include <atomic>
+#include <cstddef>
 #include <memory>
+#include <thread>
+#include <vector>
 
 namespace cet::detail {
+  // Raised whenever an entry of a governed cache becomes unused (see
+  // memory_governor.h).  The flag is read before it is written, so
+  // that releases do not contend on it once it has been raised.
+  struct release_signal {
+    std::atomic<std::atomic<bool>*> flag{nullptr};
+
+    void
+    raise() const noexcept
+    {
+      auto* const f = flag.load(std::memory_order_relaxed);
+      if (f != nullptr and not f->load(std::memory_order_relaxed)) {
+        f->store(true);
+      }
+    }
+  };
+
   struct entry_count {
+    static constexpr unsigned int erased = -1u;
+    static constexpr unsigned int busy = -2u;
+    static constexpr unsigned int compressed = -3u;
+
     entry_count(std::size_t id, unsigned int n) : sequence_number{id}, use_count{n} {}
+
+    bool
+    unused() const noexcept
+    {
+      auto const n = use_count.load();
+      return n == 0u or n == compressed;
+    }
+
+    // Drops one reference to the entry.
+    void
+    release() noexcept
+    {
+      if (--use_count == 0u and on_release != nullptr) {
+        on_release->raise();
+      }
+    }
+
     std::size_t sequence_number;
     std::atomic<unsigned int> use_count;
+    std::atomic<bool> superseded{false};
+    std::size_t bytes{}; // Estimated memory of the entry (see memory_governor.h)
+    release_signal const* on_release{nullptr};
   };
 
   using entry_count_ptr = std::shared_ptr<entry_count>;
@@ -41,7 +100,12 @@ namespace cet::detail {
 
     template <typename U = T>
     concurrent_cache_entry(U&& u, entry_count_ptr counter)
-      : value_{std::make_unique<T>(std::forward<U>(u))}, count_{std::move(counter)}
+      : value_{std::make_shared<T const>(std::forward<U>(u))}, count_{std::move(counter)}
+    {}
+
+    // Used when the value is shared with other entries.
+    concurrent_cache_entry(std::shared_ptr<T const> payload, entry_count_ptr counter)
+      : value_{std::move(payload)}, count_{std::move(counter)}
     {}
 
     T const&
@@ -54,15 +118,90 @@ namespace cet::detail {
       return *value_;
     }
 
+    std::shared_ptr<T const> const&
+    payload() const noexcept
+    {
+      return value_;
+    }
+
+    // Returns false if the entry has been erased.
+    bool
+    try_increment_reference_count()
+    {
+      return try_acquire(*count_, *this);
+    }
+
+    enum class acquisition { acquired, erased, busy };
+
+    // Acquires a reference to the entry through its counter.  The entry
+    // itself is accessed only once the reference has been acquired, so
+    // the entry may already have been erased when this function is
+    // called, provided the caller shares ownership of the counter.
+    static bool
+    try_acquire(entry_count& count, concurrent_cache_entry& entry)
+    {
+      while (true) {
+        switch (try_acquire_nowait(count, entry)) {
+        case acquisition::acquired: return true;
+        case acquisition::erased: return false;
+        case acquisition::busy: std::this_thread::yield();
+        }
+      }
+    }
+
+    // As above, but does not wait for another thread that is
+    // compressing or restoring the entry's value.
+    static acquisition
+    try_acquire_nowait(entry_count& count, concurrent_cache_entry& entry)
+    {
+      auto& use_count = count.use_count;
+      auto n = use_count.load();
+      while (true) {
+        switch (n) {
+        case entry_count::erased: return acquisition::erased;
+        case entry_count::busy: return acquisition::busy;
+        case entry_count::compressed:
+          if (use_count.compare_exchange_weak(n, entry_count::busy)) {
+            entry.restore_();
+            use_count.store(1u);
+            return acquisition::acquired;
+          }
+          continue;
+        default:
+          if (use_count.compare_exchange_weak(n, n + 1)) {
+            return acquisition::acquired;
+          }
+        }
+      }
+    }
+
     void
     increment_reference_count()
     {
-      ++count_->use_count;
+      if (not try_increment_reference_count()) {
+        throw cet::exception("Invalid cache entry access.")
+          << "Cache entry " << count_->sequence_number << " has been erased.";
+      }
     }
+
     void
     decrement_reference_count()
     {
-      --count_->use_count;
+      count_->release();
+    }
+
+    // Marks an unused entry as erased, after which no reference to it
+    // can be acquired.  Returns false if the entry is in use.
+    bool
+    try_mark_erased()
+    {
+      auto& use_count = count_->use_count;
+      for (auto n : {0u, entry_count::compressed}) {
+        if (use_count.compare_exchange_strong(n, entry_count::erased)) {
+          return true;
+        }
+      }
+      return false;
     }
 
     std::size_t
@@ -71,14 +210,115 @@ namespace cet::detail {
       return count_->sequence_number;
     }
 
+    entry_count_ptr const&
+    counter() const noexcept
+    {
+      return count_;
+    }
+
+    // Returns 0 for unused, compressed entries.
     unsigned int
     reference_count() const noexcept
     {
-      return count_->use_count;
+      auto const n = count_->use_count.load();
+      return n == entry_count::compressed ? 0u : n;
+    }
+
+    bool
+    compressed() const noexcept
+    {
+      return count_->use_count == entry_count::compressed;
+    }
+
+    // Replaces the value of an unused entry by its compressed
+    // representation, provided the representation is smaller than the
+    // value and the value is not shared with any other entry.  Returns
+    // true if the entry is stored compressed upon return.  A value that
+    // does not shrink is not submitted to the codec again.
+    bool
+    compress()
+    {
+      if constexpr (has_cache_codec_v<T>) {
+        if (incompressible_) {
+          return false;
+        }
+        auto& use_count = count_->use_count;
+        if (auto n = 0u; not use_count.compare_exchange_strong(n, entry_count::busy)) {
+          return n == entry_count::compressed;
+        }
+
+        bool const success = compress_();
+        use_count.store(success ? entry_count::compressed : 0u);
+        return success;
+      }
+      else {
+        return false;
+      }
     }
 
   private:
-    std::unique_ptr<T> value_{nullptr};
+    // An estimate of the heap memory owned by the value, used only to
+    // decide whether compression is worthwhile.
+    template <typename U>
+    static std::size_t
+    heap_size_(U const& u)
+    {
+      if constexpr (std::is_trivially_copyable_v<U>) {
+        return 0;
+      }
+      else if constexpr (detail::has_capacity<U>::value) {
+        return u.capacity() * sizeof(typename U::value_type);
+      }
+      else {
+        // No estimate available; assume the codec knows best.
+        return -1ull / 2;
+      }
+    }
+
+    // Must be called while the entry is busy.
+    bool
+    compress_()
+    {
+      if (value_ == nullptr or value_.use_count() != 1) {
+        return false;
+      }
+      try {
+        auto bytes = cache_codec<T>::compress(*value_);
+        if (std::empty(bytes) or std::size(bytes) >= sizeof(T) + heap_size_(*value_)) {
+          incompressible_ = true;
+          return false;
+        }
+        bytes.shrink_to_fit();
+        compressed_ = std::move(bytes);
+      }
+      catch (...) {
+        // Compression is an optimization; leave the entry as is.
+        incompressible_ = true;
+        return false;
+      }
+      value_.reset();
+      return true;
+    }
+
+    // Must be called while the entry is busy.
+    void
+    restore_()
+    {
+      if constexpr (has_cache_codec_v<T>) {
+        try {
+          value_ = std::make_shared<T const>(cache_codec<T>::decompress(compressed_));
+        }
+        catch (...) {
+          count_->use_count.store(entry_count::compressed);
+          throw;
+        }
+        compressed_ = {};
+      }
+    }
+
+    std::shared_ptr<T const> value_{nullptr};
+    std::vector<std::byte> compressed_{};
+    bool incompressible_{false}; // Written only while the entry is busy
     entry_count_ptr count_{make_invalid_counter()};
   };
 }
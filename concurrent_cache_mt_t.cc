@@ -3,6 +3,7 @@
 #include "cetlib/container_algorithms.h"
 
 #include "cetlib/concurrent_cache.h"
+#include "cetlib/memory_governor.h"
 #include "cetlib/test/interval_of_validity.h"
 
 #include "tbb/parallel_for_each.h"
@@ -178,3 +179,204 @@ TEST_CASE("User-defined (multi-threaded)")
     CHECK(counter.correct_tally());
   }
 }
+
+TEST_CASE("Epoch-protected reads (multi-threaded)")
+{
+  auto const events = event_numbers();
+  value_counter counter;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{
+    cet::cache_option::epoch_protection};
+
+  tbb::parallel_for_each(events, [&cache, &counter](unsigned const event) {
+    {
+      auto const guard = cache.read_guard();
+      if (auto v = cache.entry_for(event, guard)) {
+        counter.tally(event, *v);
+        cache.drop_unused();
+        return;
+      }
+    }
+    for (auto const& [iov, value] : iovs) {
+      if (iov.supports(event)) {
+        counter.tally(event, *cache.emplace(iov, value));
+      }
+    }
+    cache.drop_unused();
+  });
+  CHECK(counter.correct_tally());
+}
+
+TEST_CASE("Optimistic reads (multi-threaded)")
+{
+  auto const events = event_numbers();
+  value_counter counter;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{
+    cet::cache_option::optimistic_reads};
+
+  tbb::parallel_for_each(events, [&cache, &counter](unsigned const event) {
+    auto h = cache.entry_for(event);
+    if (not h) {
+      for (auto const& [iov, value] : iovs) {
+        if (iov.supports(event)) {
+          h = cache.emplace(iov, value);
+        }
+      }
+    }
+    counter.tally(event, *h);
+    h.invalidate();
+    cache.drop_unused();
+  });
+  CHECK(counter.correct_tally());
+}
+
+TEST_CASE("Interval index snapshots (multi-threaded)")
+{
+  cet::concurrent_cache<interval_of_validity, unsigned> cache;
+  std::vector<unsigned> points(1000);
+  std::iota(begin(points), end(points), 0);
+  std::atomic<unsigned> mismatches{};
+  tbb::parallel_for_each(points, [&cache, &mismatches](unsigned const p) {
+    if (p % 10 == 0) {
+      cache.emplace(make_iov(p, p + 10), p / 10);
+    }
+    else if (auto h = cache.entry_for(p); h and *h != p / 10) {
+      ++mismatches;
+    }
+  });
+  CHECK(mismatches == 0u);
+  CHECK(*cache.entry_for(999u) == 99u);
+}
+
+TEST_CASE("Non-blocking access (multi-threaded)")
+{
+  using namespace std::chrono_literals;
+  cet::concurrent_cache<unsigned, unsigned> cache;
+  std::vector<unsigned> keys(1000);
+  std::iota(begin(keys), end(keys), 0);
+  std::atomic<unsigned> mismatches{};
+  tbb::parallel_for_each(keys, [&cache, &mismatches](unsigned const k) {
+    auto const key = k % 10;
+    if (auto h = cache.emplace_nowait(key, key); h and **h != key) {
+      ++mismatches;
+    }
+    if (auto g = cache.at_for(key, 1ms); g and *g and **g != key) {
+      ++mismatches;
+    }
+    cache.drop_unused();
+  });
+  CHECK(mismatches == 0u);
+  CHECK(cache.size() <= 10ull);
+}
+
+TEST_CASE("Non-blocking reads are never busy without writers (multi-threaded)")
+{
+  cet::concurrent_cache<unsigned, unsigned> cache;
+  for (unsigned k{}; k != 64u; ++k) {
+    cache.emplace(k, k);
+  }
+  std::vector<unsigned> keys(100'000);
+  std::iota(begin(keys), end(keys), 0);
+  std::atomic<unsigned> busy{};
+  tbb::parallel_for_each(keys, [&cache, &busy](unsigned const k) {
+    if (not cache.try_at(k % 64)) {
+      ++busy;
+    }
+  });
+  CHECK(busy == 0u);
+}
+
+TEST_CASE("Lazy construction happens once per key (multi-threaded)")
+{
+  using namespace std::chrono_literals;
+  struct slow {
+    explicit slow(std::atomic<unsigned>& constructions, unsigned const v) : value{v}
+    {
+      ++constructions;
+      std::this_thread::sleep_for(1ms); // Widens the window for races
+    }
+    unsigned value;
+  };
+  cet::concurrent_cache<unsigned, slow> cache;
+  std::atomic<unsigned> constructions{};
+  std::atomic<unsigned> mismatches{};
+  std::vector<std::thread> threads;
+  for (unsigned t{}; t != 8u; ++t) {
+    threads.emplace_back([&] {
+      for (unsigned key{}; key != 4u; ++key) {
+        if (auto h = cache.try_emplace(key, constructions, key); h->value != key) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  CHECK(mismatches == 0u);
+  CHECK(constructions == 4u);
+}
+
+TEST_CASE("Non-blocking reads do not wait for writers (multi-threaded)")
+{
+  using namespace std::chrono_literals;
+  struct slow {
+    slow(std::atomic<bool>& started, std::atomic<bool>& release)
+    {
+      started = true;
+      while (not release) {
+        std::this_thread::yield();
+      }
+    }
+  };
+  cet::concurrent_cache<unsigned, slow> cache;
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+  std::thread writer{[&] { cache.try_emplace(1u, started, release); }};
+  while (not started) {
+    std::this_thread::yield();
+  }
+  // The writer holds the entry's lock while constructing the value.
+  CHECK_FALSE(cache.try_at(1u).has_value());
+  CHECK_FALSE(cache.at_for(1u, 10ms).has_value());
+
+  std::thread reader{[&] {
+    auto h = cache.at_for(1u, std::chrono::hours::max());
+    CHECK((h and *h));
+  }};
+  std::this_thread::sleep_for(10ms);
+  release = true;
+  writer.join();
+  reader.join();
+  auto h = cache.try_at(1u);
+  CHECK((h and *h));
+}
+
+TEST_CASE("Reclaiming while a governed cache is shrunk (multi-threaded)")
+{
+  cet::memory_governor governor{-1ull};
+  cet::concurrent_cache<unsigned, std::vector<double>> busy;
+  cet::concurrent_cache<unsigned, std::vector<double>> idle;
+  busy.join(governor);
+  idle.join(governor, 1e-3);
+  for (unsigned i{}; i != 100u; ++i) {
+    idle.emplace(i, std::vector<double>(10));
+  }
+  // Each emplacement into 'busy' reclaims an entry from 'idle', until
+  // it is empty.
+  governor.set_budget(governor.usage());
+  std::atomic<bool> done{false};
+  std::thread emplacer{[&] {
+    for (unsigned i{}; i != 1000u; ++i) {
+      busy.emplace(i, std::vector<double>(10));
+    }
+    done = true;
+  }};
+  // Neither function may be called concurrently with another member
+  // function of 'idle', but the governor may reclaim from it.
+  while (not done) {
+    idle.reserve(16);
+    idle.shrink_to_fit();
+  }
+  emplacer.join();
+  CHECK(governor.usage() == busy.memory_usage() + idle.memory_usage());
+}
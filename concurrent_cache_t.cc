@@ -1,11 +1,77 @@
 #define BOOST_TEST_MODULE (concurrent_cache test)
 #include "cetlib/quiet_unit_test.hpp"
 
+#include "cetlib/cache_handle_view.h"
 #include "cetlib/concurrent_cache.h"
+#include "cetlib/hierarchical_cache.h"
+#include "cetlib/interval.h"
+#include "cetlib/iov_cursor.h"
+#include "cetlib/key_interner.h"
+#include "cetlib/memory_governor.h"
+#include "cetlib/memory_monitor.h"
+#include "cetlib/pin_scope.h"
 #include "cetlib/test/interval_of_validity.h"
+#include "cetlib/weak_cache_handle.h"
 
+#include <atomic>
+#include <list>
+#include <numeric>
+#include <random>
 #include <regex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 #include <utility>
+#include <vector>
+
+namespace {
+  struct calibration_table {
+    std::vector<double> constants;
+  };
+
+  std::atomic<unsigned> compressions{};
+}
+
+namespace {
+  enum class crate_id : unsigned {};
+  enum class channel_offset : int {};
+}
+
+template <>
+struct cet::is_dense_key<crate_id> : std::true_type {};
+
+template <>
+struct cet::is_dense_key<channel_offset> : std::true_type {};
+
+template <>
+struct std::hash<crate_id> {
+  std::size_t
+  operator()(crate_id const id) const noexcept
+  {
+    return std::hash<unsigned>{}(static_cast<unsigned>(id));
+  }
+};
+
+template <>
+struct cet::cache_codec<calibration_table> {
+  static std::vector<std::byte>
+  compress(calibration_table const& table)
+  {
+    ++compressions;
+    auto bytes = cache_codec<std::vector<double>>::compress(table.constants);
+    if (std::size(bytes) >= std::size(table.constants) * sizeof(double)) {
+      return {}; // Not worth compressing
+    }
+    return bytes;
+  }
+
+  static calibration_table
+  decompress(std::vector<std::byte> const& bytes)
+  {
+    return {cache_codec<std::vector<double>>::decompress(bytes)};
+  }
+};
 
 namespace cet {
   template <typename T>
@@ -125,4 +191,982 @@ BOOST_AUTO_TEST_CASE(user_defined)
   BOOST_TEST(cache.entry_for(10));
 }
 
+BOOST_AUTO_TEST_CASE(codec_round_trip)
+{
+  std::vector<int> repetitive(10'000);
+  std::iota(begin(repetitive), end(repetitive), 0);
+  for (auto& i : repetitive) {
+    i %= 7;
+  }
+  auto const bytes = cet::cache_codec<std::vector<int>>::compress(repetitive);
+  BOOST_TEST(std::size(bytes) < std::size(repetitive) * sizeof(int) / 10);
+  BOOST_TEST(cet::cache_codec<std::vector<int>>::decompress(bytes) == repetitive);
+
+  std::string const text{"abracadabra, abracadabra, abracadabra"};
+  BOOST_TEST(cet::cache_codec<std::string>::decompress(cet::cache_codec<std::string>::compress(
+               text)) == text);
+  BOOST_TEST(cet::cache_codec<std::string>::decompress(cet::cache_codec<std::string>::compress(
+               "")) == "");
+}
+
+BOOST_AUTO_TEST_CASE(compressed_retained_entries)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<std::string, std::regex>{cet::cache_option::compress_retained}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  cet::concurrent_cache<unsigned, calibration_table> cache{cet::cache_option::compress_retained};
+  calibration_table table{std::vector<double>(1000, 1.5)};
+  {
+    auto h = cache.emplace(1, table);
+    cache.emplace(2, table);
+    cache.drop_unused_but_last(1);
+    BOOST_TEST(compressions == 1u); // Entry 1 is still in use
+    BOOST_TEST(cache.size() == 2ull);
+  }
+  cache.drop_unused_but_last(2);
+  BOOST_TEST(compressions == 2u); // Entry 2 was already compressed
+  BOOST_TEST(cache.size() == 2ull);
+
+  auto h = cache.at(1);
+  BOOST_TEST(h->constants == table.constants);
+  h = cache.at(2);
+  BOOST_TEST(h->constants == table.constants);
+  cache.drop_unused_but_last(2);
+  BOOST_TEST(compressions == 3u); // Entry 2 is still in use
+  BOOST_TEST(cache.at(1)->constants == table.constants);
+
+  // Values that do not shrink are submitted to the codec only once.
+  std::mt19937_64 engine{42};
+  std::uniform_real_distribution<double> uniform;
+  calibration_table noise;
+  std::generate_n(std::back_inserter(noise.constants), 1000, [&] { return uniform(engine); });
+  h.invalidate();
+  cache.drop_unused();
+  cache.emplace(3, noise);
+  cache.drop_unused_but_last(1);
+  cache.drop_unused_but_last(1);
+  BOOST_TEST(compressions == 4u);
+  BOOST_TEST(cache.at(3)->constants == noise.constants);
+
+  // No codec is available for std::vector<bool>, which does not store
+  // its elements contiguously.
+  static_assert(not cet::detail::has_cache_codec_v<std::vector<bool>>);
+  cet::concurrent_cache<unsigned, std::vector<bool>> flags;
+  flags.emplace(1u, std::vector<bool>(10, true));
+  flags.drop_unused_but_last(1);
+  BOOST_TEST(flags.size() == 1ull);
+}
+
+BOOST_AUTO_TEST_CASE(deduplicated_values)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<std::string, calibration_table>{cet::cache_option::deduplicate_values}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  cet::concurrent_cache<cet::test::interval_of_validity, std::vector<double>> cache{
+    cet::cache_option::deduplicate_values};
+  std::vector<double> const constants(100, 2.5);
+  auto h1 = cache.emplace({1, 10}, constants);
+  auto h2 = cache.emplace({10, 20}, constants);
+  auto h3 = cache.emplace({20, 30}, std::vector<double>(100, 3.5));
+  BOOST_TEST(size(cache) == 3ull);
+  BOOST_TEST(&*h1 == &*h2);
+  BOOST_TEST(&*h1 != &*h3);
+
+  h1.invalidate();
+  cache.drop_unused();
+  BOOST_TEST(size(cache) == 2ull);
+  BOOST_TEST(*h2 == constants);
+
+  // The payload of an erased entry can be shared by a new entry as
+  // long as another entry still refers to it.
+  auto h4 = cache.emplace({30, 40}, constants);
+  BOOST_TEST(&*h2 == &*h4);
+
+  for (auto* h : {&h2, &h3, &h4}) {
+    h->invalidate();
+  }
+  cache.shrink_to_fit();
+  BOOST_TEST(empty(cache));
+}
+
+BOOST_AUTO_TEST_CASE(coalesced_intervals)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<std::string, int>{cet::cache_option::coalesce_intervals}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{
+    cet::cache_option::coalesce_intervals};
+  cache.emplace({1, 10}, "Good");
+  cache.emplace({20, 30}, "Good");
+  cache.emplace({30, 40}, "Bad");
+  BOOST_TEST(size(cache) == 3ull);
+
+  // Bridges [1, 10) and [20, 30), but not [30, 40)
+  auto h = cache.emplace({10, 20}, "Good");
+  BOOST_TEST(*h == "Good");
+  BOOST_TEST(cache.at({1, 30}));
+  BOOST_TEST(not cache.at({10, 20}));
+  BOOST_TEST(&*cache.entry_for(5) == &*cache.entry_for(25));
+  BOOST_TEST(*cache.entry_for(35) == "Bad");
+
+  // Superseded entries are erased even if retention is requested.
+  h.invalidate();
+  cache.drop_unused_but_last(2);
+  BOOST_TEST(size(cache) == 2ull);
+  BOOST_TEST(not cache.at({1, 10}));
+  BOOST_TEST(not cache.at({20, 30}));
+  BOOST_TEST(*cache.entry_for(15) == "Good");
+}
+
+BOOST_AUTO_TEST_CASE(event_ranges)
+{
+  using cet::event_id;
+  using cet::event_range;
+  cet::concurrent_cache<event_range, std::string> cache;
+  cache.emplace(event_range{{1, 0, 0}, {2, 0, 0}}, "Run 1");
+  cache.emplace(event_range{{2, 0, 0}, {2, 5, 0}}, "Run 2, early subruns");
+  cache.emplace(event_range{{2, 5, 0}, {2, 5, 100}}, "Run 2, subrun 5");
+
+  BOOST_TEST(not cache.entry_for(event_id{0, 10, 10}));
+  BOOST_TEST(*cache.entry_for(event_id{1, 7, 1000}) == "Run 1");
+  BOOST_TEST(*cache.entry_for(event_id{2, 4, -1u}) == "Run 2, early subruns");
+  BOOST_TEST(*cache.entry_for(event_id{2, 5, 99}) == "Run 2, subrun 5");
+  BOOST_TEST(not cache.entry_for(event_id{2, 5, 100}));
+
+  cache.emplace(event_range{{2, 4, 0}, {2, 6, 0}}, "Overlapping");
+  BOOST_CHECK_EXCEPTION(cache.entry_for(event_id{2, 5, 1}), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Data retrieval error."});
+  });
+  BOOST_TEST(*cache.entry_for(event_id{1, 7, 1000}) == "Run 1");
+
+  cache.drop_unused_but_last(1);
+  BOOST_TEST(size(cache) == 1ull);
+  BOOST_TEST(not cache.entry_for(event_id{1, 7, 1000}));
+  BOOST_TEST(*cache.entry_for(event_id{2, 5, 1}) == "Overlapping");
+}
+
+BOOST_AUTO_TEST_CASE(timestamp_ranges)
+{
+  using cet::timestamp_range;
+  cet::concurrent_cache<timestamp_range, int> cache;
+  std::uint64_t const t0 = 1'700'000'000'000'000'000ull;
+  for (int i{}; i != 100; ++i) {
+    cache.emplace(timestamp_range{t0 + i * 1000ull, t0 + (i + 1) * 1000ull}, i);
+  }
+  BOOST_TEST(not cache.entry_for(t0 - 1));
+  BOOST_TEST(*cache.entry_for(t0) == 0);
+  BOOST_TEST(*cache.entry_for(t0 + 42'999ull) == 42);
+  BOOST_TEST(not cache.entry_for(t0 + 100'000ull));
+}
+
+BOOST_AUTO_TEST_CASE(hierarchical_levels)
+{
+  using cet::event_id;
+  using cet::event_range;
+  cet::hierarchical_cache<std::string, event_range, event_range> cache{{1, 1}};
+  cache.emplace<1>(event_range{{1, 0, 0}, {2, 0, 0}}, "Run 1");
+  cache.emplace<0>(event_range{{1, 3, 0}, {1, 4, 0}}, "Run 1, subrun 3");
+
+  BOOST_TEST(*cache.entry_for(event_id{1, 2, 7}) == "Run 1");
+  BOOST_TEST(*cache.entry_for(event_id{1, 3, 7}) == "Run 1, subrun 3");
+  BOOST_TEST(not cache.entry_for(event_id{2, 0, 0}));
+
+  cache.emplace<0>(event_range{{1, 4, 0}, {1, 5, 0}}, "Run 1, subrun 4");
+  cache.drop_unused();
+  BOOST_TEST(size(cache.level<0>()) == 1ull);
+  BOOST_TEST(size(cache.level<1>()) == 1ull);
+  BOOST_TEST(*cache.entry_for(event_id{1, 3, 7}) == "Run 1");
+  BOOST_TEST(*cache.entry_for(event_id{1, 4, 7}) == "Run 1, subrun 4");
+}
+
+BOOST_AUTO_TEST_CASE(rejected_overlaps)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<std::string, int>{cet::cache_option::reject_overlaps}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{
+    cet::cache_option::reject_overlaps};
+  cache.emplace({1, 10}, "Run 1");
+  cache.emplace({10, 20}, "Run 2");
+  BOOST_CHECK_EXCEPTION(cache.emplace({5, 15}, "Run 3"), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Cache insertion error."});
+  });
+  BOOST_TEST(size(cache) == 2ull);
+  BOOST_TEST(*cache.emplace({10, 20}, "Ignored") == "Run 2");
+}
+
+BOOST_AUTO_TEST_CASE(newest_interval_wins)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{cet::cache_option::newest_wins};
+  auto h1 = cache.emplace({1, 10}, "Run 1");
+  cache.emplace({10, 20}, "Run 2");
+  cache.emplace({5, 15}, "Run 3");
+
+  BOOST_TEST(*cache.entry_for(3) == "Run 1");
+  BOOST_TEST(&*cache.entry_for(3) == &*h1);
+  BOOST_TEST(*cache.entry_for(7) == "Run 3");
+  BOOST_TEST(*cache.entry_for(12) == "Run 3");
+  BOOST_TEST(*cache.entry_for(17) == "Run 2");
+  BOOST_TEST(size(cache) == 5ull);
+
+  h1.invalidate();
+  cache.drop_unused_but_last(10);
+  BOOST_TEST(size(cache) == 3ull);
+  BOOST_TEST(not cache.at({1, 10}));
+  BOOST_TEST(*cache.at({1, 5}) == "Run 1");
+
+  // An interval that covers others entirely supersedes them.
+  auto h4 = cache.emplace({0, 30}, "Run 4");
+  cache.drop_unused();
+  BOOST_TEST(size(cache) == 1ull);
+  BOOST_TEST(*cache.entry_for(12) == "Run 4");
+}
+
+BOOST_AUTO_TEST_CASE(reemplaced_superseded_intervals)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache{cet::cache_option::newest_wins};
+  cache.emplace({0, 10}, "A");
+  cache.emplace({5, 15}, "B");
+  BOOST_TEST(*cache.emplace({0, 10}, "C") == "C");
+  BOOST_TEST(*cache.entry_for(2) == "C");
+  BOOST_TEST(*cache.entry_for(12) == "B");
+  BOOST_TEST(not cache.entry_for(17));
+
+  // A superseded entry that is still in use is detached from the
+  // cache, and its handles remain valid.
+  auto h = cache.at({5, 15});
+  BOOST_TEST(*cache.emplace({5, 15}, "D") == "D");
+  BOOST_TEST(*h == "B");
+  BOOST_TEST(*cache.at({5, 15}) == "D");
+  BOOST_TEST(*cache.entry_for(2) == "C");
+  BOOST_TEST(*cache.entry_for(12) == "D");
+  h.invalidate();
+  cache.drop_unused();
+  BOOST_TEST(empty(cache));
+  BOOST_TEST(cache.memory_usage() == 0u);
+
+  // Re-emplacing an interval that has been merged away, with an equal
+  // value, returns the merged entry.
+  cet::concurrent_cache<interval_of_validity, std::string> coalescing{
+    cet::cache_option::coalesce_intervals};
+  coalescing.emplace({0, 10}, "A");
+  auto const merged = coalescing.emplace({10, 20}, "A");
+  BOOST_TEST(size(coalescing) == 2ull);
+  auto const left = coalescing.at({0, 10}); // Merged away, but in use
+  BOOST_TEST(&*coalescing.emplace({10, 20}, "A") == &*merged);
+  BOOST_TEST(&*coalescing.emplace({0, 10}, "A") == &*merged);
+  BOOST_TEST(&*coalescing.emplace({5, 15}, "A") == &*merged);
+  BOOST_TEST(size(coalescing) == 2ull);
+  BOOST_TEST(&*coalescing.entry_for(5) == &*merged);
+  BOOST_TEST(&*coalescing.entry_for(15) == &*merged);
+
+  // Without an overlap policy, a different value overlaps the merged
+  // entry.
+  coalescing.emplace({10, 20}, "B");
+  BOOST_CHECK_EXCEPTION(coalescing.entry_for(15), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Data retrieval error."});
+  });
+
+  // With the newest_wins policy, it replaces the covered part.
+  cet::concurrent_cache<interval_of_validity, std::string> trimming{
+    cet::cache_option::coalesce_intervals | cet::cache_option::newest_wins};
+  trimming.emplace({0, 5}, "A");
+  trimming.emplace({5, 10}, "A");
+  auto const merged_away = trimming.at({0, 5});
+  BOOST_TEST(*trimming.emplace({0, 5}, "A") == "A");
+  BOOST_TEST(&*trimming.entry_for(2) == &*trimming.entry_for(7));
+  BOOST_TEST(*trimming.emplace({0, 5}, "Z") == "Z");
+  BOOST_TEST(*merged_away == "A");
+  BOOST_TEST(*trimming.entry_for(2) == "Z");
+  BOOST_TEST(*trimming.entry_for(7) == "A");
+}
+
+BOOST_AUTO_TEST_CASE(cursor)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, unsigned> cache;
+  for (unsigned i{}; i != 20; ++i) {
+    cache.emplace({10 * i, 10 * (i + 1)}, i);
+  }
+  cache.emplace({300, 310}, 30u);
+
+  cet::iov_cursor cursor{cache};
+  for (unsigned event{}; event != 200; ++event) {
+    auto const& h = cursor.advance_to(event);
+    BOOST_TEST_REQUIRE(h);
+    BOOST_TEST(*h == event / 10);
+  }
+  BOOST_TEST(not cursor.advance_to(250));
+  BOOST_TEST(*cursor.advance_to(305) == 30u);
+  BOOST_TEST(*cursor.advance_to(15) == 1u);
+
+  // The current entry remains pinned.
+  cache.drop_unused();
+  BOOST_TEST(cache.size() == 1ull);
+  BOOST_TEST(*cursor.advance_to(12) == 1u);
+  BOOST_TEST(not cursor.advance_to(25));
+
+  // The cursor notices changes to the index.
+  cache.emplace({20, 30}, 2u);
+  BOOST_TEST(*cursor.advance_to(25) == 2u);
+  cursor.reset();
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+}
+
+BOOST_AUTO_TEST_CASE(batch_lookups)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, unsigned> cache;
+  for (unsigned i{}; i != 10; ++i) {
+    cache.emplace({10 * i, 10 * (i + 1)}, i);
+  }
+
+  std::vector<unsigned> const hits{1, 2, 3, 15, 17, 55, 99, 100, 120};
+  std::vector<unsigned const*> values;
+  auto pins = cache.entry_for_many(hits, back_inserter(values));
+  BOOST_TEST_REQUIRE(values.size() == hits.size());
+  BOOST_TEST(pins.size() == 4ull);
+  for (std::size_t i{}; i != 7; ++i) {
+    BOOST_TEST_REQUIRE(values[i]);
+    BOOST_TEST(*values[i] == hits[i] / 10);
+  }
+  BOOST_TEST(values[0] == values[2]);
+  BOOST_TEST(not values[7]);
+  BOOST_TEST(not values[8]);
+
+  {
+    // An entry that recurs after another one is pinned only once.
+    std::vector<unsigned const*> revisited;
+    auto const revisit_pins =
+      cache.entry_for_many(std::vector<unsigned>{1, 15, 2, 17, 3}, back_inserter(revisited));
+    BOOST_TEST(revisit_pins.size() == 2ull);
+    BOOST_TEST(revisited[0] == revisited[2]);
+    BOOST_TEST(revisited[1] == revisited[3]);
+  }
+
+  cache.drop_unused();
+  BOOST_TEST(cache.size() == 4ull);
+  pins.clear();
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+
+  cet::concurrent_cache<std::string, int> ages;
+  ages.emplace("Alice", 97);
+  ages.emplace("Bob", 41);
+  std::vector<std::string> const names{"Alice", "Alice", "Carol", "Bob", "Alice"};
+  std::vector<int const*> result;
+  auto const age_pins = ages.at_many(names, back_inserter(result));
+  BOOST_TEST(age_pins.size() == 2ull);
+  BOOST_TEST(*result[0] == 97);
+  BOOST_TEST(result[0] == result[1]);
+  BOOST_TEST(not result[2]);
+  BOOST_TEST(*result[3] == 41);
+  BOOST_TEST(result[4] == result[0]);
+}
+
+BOOST_AUTO_TEST_CASE(pinned_entries)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache;
+  cache.emplace({1, 10}, "Run 1");
+  cache.emplace({10, 20}, "Run 2");
+  cache.emplace({20, 30}, "Run 3");
+  {
+    cet::pinned_set<std::string> pins;
+    auto v1 = cache.entry_for(5, pins);
+    auto v2 = cache.entry_for(15, pins);
+    auto v3 = cache.at({1, 10}, pins);
+    BOOST_TEST(not cache.entry_for(35, pins));
+    BOOST_TEST(pins.size() == 2ull);
+    BOOST_TEST(*v1 == "Run 1");
+    BOOST_TEST(*v2 == "Run 2");
+    BOOST_TEST(&*v1 == &*v3);
+
+    cache.drop_unused();
+    BOOST_TEST(size(cache) == 2ull);
+    BOOST_TEST(v1->size() == 5ull);
+
+    auto other_pins = std::move(pins);
+    cache.drop_unused();
+    BOOST_TEST(size(cache) == 2ull);
+  }
+  cache.drop_unused();
+  BOOST_TEST(empty(cache));
+}
+
+BOOST_AUTO_TEST_CASE(scoped_pins)
+{
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, std::string> cache;
+  cache.emplace({1, 10}, "Run 1");
+  cache.emplace({10, 20}, "Run 2");
+
+  cet::pin_scope scope{cache};
+  auto const& run_1 = scope.entry_for(5);
+  BOOST_TEST(run_1 == "Run 1");
+  BOOST_TEST(&scope.entry_for(7) == &run_1);
+  BOOST_TEST(&scope.at({1, 10}) == &run_1);
+  BOOST_TEST(scope.entry_for(15) == "Run 2");
+  BOOST_TEST(not scope.find_for(25));
+  BOOST_CHECK_EXCEPTION(scope.at({20, 30}), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Data retrieval error."});
+  });
+
+  cache.drop_unused();
+  BOOST_TEST(size(cache) == 2ull);
+  scope.close();
+  cache.drop_unused();
+  BOOST_TEST(empty(cache));
+  BOOST_TEST(not scope.find({1, 10}));
+}
+
+BOOST_AUTO_TEST_CASE(weak_handles)
+{
+  cet::concurrent_cache<std::string, unsigned> cache;
+  cet::weak_cache_handle<unsigned> weak;
+  BOOST_TEST(weak.expired());
+  BOOST_TEST(not weak.lock());
+
+  weak = cache.emplace("Alice", 97);
+  BOOST_TEST(not weak.expired());
+  cache.drop_unused_but_last(1); // Not pinned by the weak handle, but retained
+  if (auto h = weak.lock()) {
+    BOOST_TEST(*h == 97u);
+    cache.drop_unused();
+    BOOST_TEST(cache.size() == 1ull); // Pinned by the locked handle
+  }
+  else {
+    BOOST_FAIL("Weak handle should not have expired.");
+  }
+
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+  BOOST_TEST(weak.expired());
+  BOOST_TEST(not weak.lock());
+
+  // A re-emplaced entry is a different entry.
+  auto h = cache.emplace("Alice", 97);
+  BOOST_TEST(weak.expired());
+  weak = h;
+  BOOST_TEST(weak.lock());
+  weak.reset();
+  BOOST_TEST(weak.expired());
+}
+
+BOOST_AUTO_TEST_CASE(projected_handles)
+{
+  cet::concurrent_cache<unsigned, calibration_table> cache;
+  cache.emplace(1, calibration_table{{1.5, 2.5, 3.5}});
+
+  cet::cache_handle_view<double> constant;
+  BOOST_TEST(not constant);
+  {
+    auto h = cache.at(1);
+    auto constants = cet::project(h, &calibration_table::constants);
+    constant = cet::project(constants, [](auto const& cs) -> double const& { return cs[1]; });
+    BOOST_TEST(&constants->front() == &h->constants.front());
+  }
+  BOOST_TEST(*constant == 2.5);
+  cache.drop_unused();
+  BOOST_TEST(cache.size() == 1ull); // Pinned by the view
+
+  auto copy = constant;
+  constant.invalidate();
+  cache.drop_unused();
+  BOOST_TEST(cache.size() == 1ull);
+  copy.invalidate();
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+
+  BOOST_CHECK_EXCEPTION(
+    cet::project(cache.at(1), &calibration_table::constants), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Invalid cache handle dereference."});
+    });
+}
+
+BOOST_AUTO_TEST_CASE(shared_pointers)
+{
+  cet::concurrent_cache<std::string, unsigned> cache;
+  BOOST_TEST(not cet::to_shared_ptr(cache.at("Alice")));
+
+  auto h = cache.emplace("Alice", 97);
+  auto p = cet::to_shared_ptr(h);
+  BOOST_TEST(p.get() == &*h);
+  h.invalidate();
+
+  std::shared_ptr<unsigned const> q = p;
+  p.reset();
+  cache.drop_unused();
+  BOOST_TEST(cache.size() == 1ull); // Pinned by q
+  BOOST_TEST(*q == 97u);
+  q.reset();
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+}
+
+BOOST_AUTO_TEST_CASE(epoch_protected_reads)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<unsigned, calibration_table>{cet::cache_option::epoch_protection |
+                                                        cet::cache_option::compress_retained}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  cet::concurrent_cache<std::string, std::string> unprotected;
+  BOOST_CHECK_EXCEPTION(unprotected.read_guard(), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+  });
+  cet::concurrent_cache<crate_id, std::string> unprotected_dense;
+  BOOST_CHECK_EXCEPTION(unprotected_dense.read_guard(), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+  });
+
+  cet::concurrent_cache<std::string, std::string> cache{cet::cache_option::epoch_protection};
+  cache.emplace("Alice", "Bob");
+  {
+    auto const guard = cache.read_guard();
+    BOOST_CHECK_EXCEPTION(unprotected.at("Alice", guard), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Data retrieval error."});
+    });
+    BOOST_TEST(not cache.at("Carol", guard));
+
+    auto v = cache.at("Alice", guard);
+    BOOST_TEST(*v == "Bob");
+    cache.drop_unused(); // Not pinned by the read
+    BOOST_TEST(cache.empty());
+    BOOST_TEST(not cache.at("Alice", guard));
+    BOOST_TEST(*v == "Bob"); // Destruction deferred until the guard is gone
+  }
+
+  auto h = cache.emplace("Alice", "Dave");
+  auto const guard = cache.read_guard();
+  BOOST_TEST(*cache.at("Alice", guard) == "Dave");
+}
+
+BOOST_AUTO_TEST_CASE(optimistic_reads)
+{
+  cet::concurrent_cache<std::string, std::string> cache{cet::cache_option::optimistic_reads};
+  BOOST_TEST(not cache.at("Alice"));
+  cache.emplace("Alice", "Bob");
+  {
+    auto h = cache.at("Alice");
+    BOOST_TEST(*h == "Bob");
+    cache.drop_unused();
+    BOOST_TEST(cache.size() == 1ull); // Pinned by the optimistically retrieved handle
+  }
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+  BOOST_TEST(not cache.at("Alice"));
+
+  cache.emplace("Alice", "Carol");
+  BOOST_TEST(*cache.at("Alice") == "Carol");
+
+  // Once all read guards are in use, lookups are made as without the
+  // option.
+  cet::concurrent_cache<std::string, std::string> guarded{cet::cache_option::epoch_protection |
+                                                          cet::cache_option::optimistic_reads};
+  guarded.emplace("Alice", "Bob");
+  std::vector<cet::epoch_guard> guards;
+  for (unsigned i{}; i != 128; ++i) {
+    guards.push_back(guarded.read_guard());
+  }
+  BOOST_CHECK_EXCEPTION(guarded.read_guard(), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Data retrieval error."});
+  });
+  BOOST_TEST(*guarded.at("Alice") == "Bob");
+  guards.pop_back();
+  BOOST_TEST(*guarded.at("Alice", guarded.read_guard()) == "Bob");
+}
+
+BOOST_AUTO_TEST_CASE(non_blocking_access)
+{
+  using namespace std::chrono_literals;
+  cet::concurrent_cache<std::string, unsigned> cache;
+  auto absent = cache.try_at("Alice");
+  BOOST_TEST((absent and not *absent)); // Not busy, but no entry
+
+  auto h = cache.emplace_nowait("Alice", 97);
+  BOOST_TEST((h and **h == 97u));
+  auto g = cache.at_for("Alice", 10ms);
+  BOOST_TEST((g and **g == 97u));
+  // The deadline saturates instead of overflowing
+  auto forever = cache.at_for("Alice", std::chrono::hours::max());
+  BOOST_TEST((forever and **forever == 97u));
+  auto nanoforever = cache.at_for("Alice", std::chrono::nanoseconds::max());
+  BOOST_TEST((nanoforever and **nanoforever == 97u));
+  auto expired = cache.at_for("Alice", std::chrono::nanoseconds::min());
+  BOOST_TEST((expired and **expired == 97u)); // Not busy, so no waiting
+
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, unsigned> intervals{
+    cet::cache_option::reject_overlaps};
+  auto i = intervals.emplace_nowait({1, 10}, 1);
+  BOOST_TEST((i and **i == 1u));
+}
+
+BOOST_AUTO_TEST_CASE(lazy_construction)
+{
+  struct counted {
+    explicit counted(unsigned& n, std::string s) : value{std::move(s)} { ++n; }
+    std::string value;
+  };
+
+  unsigned constructions{};
+  cet::concurrent_cache<std::string, counted> cache;
+  auto h = cache.try_emplace("Alice", constructions, "Bob");
+  BOOST_TEST(h->value == "Bob");
+  BOOST_TEST(constructions == 1u);
+
+  std::string key{"Alice"};
+  auto g = cache.try_emplace(std::move(key), constructions, "Carol");
+  BOOST_TEST(g->value == "Bob"); // Existing entry
+  BOOST_TEST(constructions == 1u);
+
+  cet::concurrent_cache<std::string, std::vector<int>> dedup{
+    cet::cache_option::deduplicate_values};
+  auto a = dedup.try_emplace("a", 3, 1);
+  auto b = dedup.try_emplace("b", 3, 1);
+  BOOST_TEST(&*a == &*b);
+
+  // A value whose construction fails leaves no entry behind.
+  struct fragile {
+    explicit fragile(bool const fail)
+    {
+      if (fail) {
+        throw std::runtime_error{"Construction failed."};
+      }
+    }
+  };
+  cet::concurrent_cache<unsigned, fragile> fragiles;
+  BOOST_CHECK_THROW(fragiles.try_emplace(1u, true), std::runtime_error);
+  BOOST_TEST(fragiles.empty());
+  BOOST_TEST(fragiles.memory_usage() == 0ull);
+  BOOST_TEST(not fragiles.at(1u));
+  BOOST_CHECK(fragiles.try_emplace(1u, false));
+  BOOST_CHECK(fragiles.at(1u));
+  fragiles.drop_unused();
+  BOOST_TEST(fragiles.empty());
+}
+
+BOOST_AUTO_TEST_CASE(prehashed_and_heterogeneous_keys)
+{
+  cet::concurrent_cache<std::string, unsigned> cache;
+  cache.emplace("Alice", 97);
+
+  using namespace std::string_view_literals;
+  BOOST_TEST(*cache.at("Alice") == 97u);
+  BOOST_TEST(*cache.at("Alice"sv) == 97u);
+  BOOST_TEST(not cache.at("Bob"sv));
+
+  cet::prehashed_key const alice{std::string{"Alice"}};
+  BOOST_TEST(alice.hash() == std::hash<std::string_view>{}("Alice"sv));
+  BOOST_TEST(*cache.at(alice) == 97u);
+
+  using cet::test::interval_of_validity;
+  cet::concurrent_cache<interval_of_validity, unsigned> intervals;
+  intervals.emplace({1, 10}, 1);
+  cet::prehashed_key const key{interval_of_validity{1, 10}};
+  BOOST_TEST(*intervals.at(key) == 1u);
+  BOOST_TEST(not intervals.at(cet::prehashed_key{interval_of_validity{1, 11}}));
+}
+
+BOOST_AUTO_TEST_CASE(interval_hash_collisions)
+{
+  using cet::test::interval_of_validity;
+  // All intervals [a, b) with a, b < 128, including the empty and the
+  // reversed ones, which collide under XOR-based combinations.
+  constexpr unsigned n = 128;
+  constexpr std::size_t n_buckets = 1024;
+  auto collisions = [](auto make_key) {
+    using key_t = decltype(make_key(0u, 0u));
+    std::unordered_set<std::size_t> hashes;
+    std::vector<unsigned> buckets(n_buckets);
+    for (unsigned a{}; a != n; ++a) {
+      for (unsigned b{}; b != n; ++b) {
+        auto const h = std::hash<key_t>{}(make_key(a, b));
+        hashes.insert(h);
+        ++buckets[h % n_buckets];
+      }
+    }
+    auto const max_load = *std::max_element(cbegin(buckets), cend(buckets));
+    return std::make_pair(n * n - std::size(hashes), max_load);
+  };
+
+  auto const [iov_collisions, iov_max_load] =
+    collisions([](unsigned a, unsigned b) { return interval_of_validity{a, b}; });
+  BOOST_TEST(iov_collisions == 0ull);
+  BOOST_TEST(iov_max_load < 4 * n * n / n_buckets);
+
+  auto const [range_collisions, range_max_load] =
+    collisions([](unsigned a, unsigned b) { return cet::timestamp_range{a, b}; });
+  BOOST_TEST(range_collisions == 0ull);
+  BOOST_TEST(range_max_load < 4 * n * n / n_buckets);
+
+  BOOST_TEST(std::hash<cet::event_id>{}({1, 2, 3}) != std::hash<cet::event_id>{}({3, 2, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(dense_keys)
+{
+  BOOST_CHECK_EXCEPTION(
+    (cet::concurrent_cache<crate_id, calibration_table>{cet::cache_option::compress_retained}),
+    cet::exception,
+    [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  cet::concurrent_cache<crate_id, std::string> cache;
+  BOOST_TEST(not cache.at(crate_id{3}));
+  cache.emplace(crate_id{3}, "Crate 3");
+  cache.emplace(crate_id{1000}, "Crate 1000");
+  BOOST_TEST(*cache.at(crate_id{3}) == "Crate 3");
+  BOOST_TEST(*cache.at(crate_id{1000}) == "Crate 1000");
+  BOOST_TEST(not cache.at(crate_id{4}));
+  BOOST_TEST(not cache.at(crate_id{1u << 30}));
+
+  {
+    auto h = cache.at(crate_id{3});
+    cache.drop_unused();
+    BOOST_TEST(cache.size() == 1ull);
+  }
+  cache.drop_unused();
+  BOOST_TEST(cache.empty());
+  BOOST_TEST(not cache.at(crate_id{3}));
+  cache.emplace(crate_id{3}, "Crate 3, again");
+  BOOST_TEST(*cache.at(crate_id{3}) == "Crate 3, again");
+
+  // Keys beyond the capacity of the dense table are rejected up front.
+  auto const usage = cache.memory_usage();
+  BOOST_CHECK_EXCEPTION(
+    cache.emplace(crate_id{1u << 30}, "Too large"), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache insertion error."});
+    });
+  BOOST_TEST(cache.size() == 1ull);
+  BOOST_TEST(cache.memory_usage() == usage);
+  BOOST_TEST(not cache.at(crate_id{1u << 30}));
+}
+
+BOOST_AUTO_TEST_CASE(negative_dense_keys)
+{
+  cet::concurrent_cache<channel_offset, std::string> cache;
+  cache.emplace(channel_offset{0}, "Zero");
+  BOOST_TEST(not cache.at(channel_offset{-1}));
+  BOOST_CHECK_EXCEPTION(
+    cache.emplace(channel_offset{-1}, "Negative"), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache insertion error."});
+    });
+  BOOST_TEST(cache.size() == 1ull);
+  BOOST_TEST(*cache.at(channel_offset{0}) == "Zero");
+}
+
+BOOST_AUTO_TEST_CASE(interned_keys)
+{
+  cet::key_interner interner;
+  auto const alice = interner.intern("Alice");
+  auto const bob = interner.intern(std::string{"Bob"});
+  BOOST_TEST((alice != bob));
+  BOOST_TEST((interner.intern(std::string_view{"Alice"}) == alice));
+  BOOST_TEST(interner.size() == 2ull);
+  BOOST_TEST(interner.key(bob) == "Bob");
+  BOOST_TEST((interner.find("Alice") == alice));
+  BOOST_TEST(not interner.find("Carol"));
+  BOOST_CHECK_EXCEPTION(
+    interner.key(cet::interned_key{7}), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Invalid interned key."});
+    });
+
+  cet::concurrent_cache<cet::interned_key, unsigned> ages;
+  ages.emplace(alice, 97u);
+  ages.emplace(bob, 68u);
+  BOOST_TEST(*ages.at(alice) == 97u);
+  BOOST_TEST(*ages.at(interner.intern("Bob")) == 68u);
+  BOOST_TEST(not ages.at(interner.intern("Carol")));
+}
+
+BOOST_AUTO_TEST_CASE(bulk_construction)
+{
+  std::vector<std::pair<unsigned, std::string>> pairs;
+  for (unsigned i{}; i != 1000u; ++i) {
+    pairs.emplace_back(i, std::to_string(i));
+  }
+  cet::concurrent_cache<unsigned, std::string> cache{begin(pairs), end(pairs)};
+  BOOST_TEST(cache.size() == 1000ull);
+  BOOST_TEST(*cache.at(0u) == "0");
+  BOOST_TEST(*cache.at(999u) == "999");
+
+  // Each entry has its own sequence number.
+  cache.drop_unused_but_last(10);
+  BOOST_TEST(cache.size() == 10ull);
+
+  std::list<std::pair<std::string, unsigned>> const ages{{"Alice", 97u}, {"Bob", 68u}};
+  cet::concurrent_cache<std::string, unsigned> by_name{begin(ages), end(ages)};
+  BOOST_TEST(by_name.size() == 2ull);
+  BOOST_TEST(*by_name.at("Bob") == 68u);
+
+  cet::concurrent_cache<unsigned, std::string> reserved;
+  reserved.reserve(1000);
+  reserved.emplace(1u, "One");
+  BOOST_TEST(*reserved.at(1u) == "One");
+}
+
+BOOST_AUTO_TEST_CASE(memory_governor)
+{
+  using table_t = std::vector<double>;
+  std::size_t one_table{};
+  {
+    cet::concurrent_cache<unsigned, table_t> scratch;
+    scratch.emplace(0u, table_t(1000));
+    one_table = scratch.memory_usage();
+  }
+
+  // The governor must outlive the caches that join it.
+  cet::memory_governor governor{10 * one_table};
+  cet::concurrent_cache<unsigned, table_t> geometry;
+  cet::concurrent_cache<unsigned, table_t> calibrations;
+  geometry.emplace(0u, table_t(1000));
+  geometry.join(governor);
+  calibrations.join(governor, 2.);
+  BOOST_TEST(governor.size() == 2ull);
+  BOOST_TEST(governor.usage() == one_table);
+
+  auto const pinned = geometry.at(0u);
+  for (unsigned i{1}; i != 5u; ++i) {
+    geometry.emplace(i, table_t(1000));
+  }
+  for (unsigned i{}; i != 8u; ++i) {
+    calibrations.emplace(i, table_t(1000));
+  }
+  // Each cache is held to its weighted share of the budget: cold
+  // geometry entries are reclaimed as the calibrations grow, except
+  // for the pinned one.
+  BOOST_TEST(governor.usage() <= governor.budget());
+  BOOST_TEST(geometry.size() == 3ull);
+  BOOST_TEST(calibrations.size() == 7ull);
+  BOOST_TEST(std::size(*geometry.at(0u)) == 1000ull);
+  BOOST_TEST(not geometry.at(1u));
+  BOOST_TEST(std::size(*geometry.at(4u)) == 1000ull);
+
+  governor.set_budget(6 * one_table);
+  BOOST_TEST(governor.usage() <= governor.budget());
+  BOOST_TEST(geometry.size() == 2ull);
+  BOOST_TEST(calibrations.size() == 4ull);
+  BOOST_TEST(governor.usage() == geometry.memory_usage() + calibrations.memory_usage());
+
+  // While all entries are in use, the budget cannot be enforced; it is
+  // enforced again once entries have been released.
+  std::vector<cet::cache_handle<table_t>> in_use;
+  for (unsigned i{10}; i != 20u; ++i) {
+    in_use.push_back(calibrations.emplace(i, table_t(1000)));
+  }
+  BOOST_TEST(governor.usage() > governor.budget());
+  BOOST_TEST(calibrations.size() == 10ull);
+  in_use.clear();
+  calibrations.emplace(20u, table_t(1000));
+  BOOST_TEST(governor.usage() <= governor.budget());
+
+  // Reclaiming is suspended, not deadlocked, while a governed cache is
+  // rehashed or shrunk.
+  calibrations.reserve(64);
+  calibrations.shrink_to_fit();
+  BOOST_TEST(governor.usage() == geometry.memory_usage() + calibrations.memory_usage());
+
+  BOOST_CHECK_EXCEPTION(geometry.join(governor), cet::exception, [](auto const& e) {
+    return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+  });
+}
+
+BOOST_AUTO_TEST_CASE(memory_monitor)
+{
+  std::size_t one_table{};
+  {
+    cet::concurrent_cache<unsigned, std::vector<double>> scratch;
+    scratch.emplace(0u, std::vector<double>(1000));
+    one_table = scratch.memory_usage();
+  }
+
+  cet::memory_governor governor{100 * one_table};
+  cet::concurrent_cache<unsigned, std::vector<double>> cache;
+  cache.emplace(0u, std::vector<double>(1000));
+  cache.join(governor);
+  for (unsigned i{1}; i != 10u; ++i) {
+    cache.emplace(i, std::vector<double>(1000));
+  }
+
+  // Watermarks at 144 and 150 tables' worth of memory
+  cet::memory_reading reading{100 * one_table, 200 * one_table};
+  cet::memory_monitor monitor{governor, {0.72, 0.75}, [&reading] { return reading; }};
+
+  monitor.poll(); // Below the low watermark
+  BOOST_TEST(cache.size() == 10ull);
+  BOOST_TEST(governor.budget() == 100 * one_table);
+
+  reading.current = 146 * one_table; // Between the watermarks
+  monitor.poll();
+  BOOST_TEST(cache.size() == 10ull);
+
+  reading.current = 150 * one_table; // Shed 6 tables to reach the low watermark
+  monitor.poll();
+  BOOST_TEST(cache.size() == 4ull);
+  BOOST_TEST(governor.usage() <= governor.budget());
+
+  reading.current = 100 * one_table; // Memory has been released
+  monitor.poll();
+  auto const recovered = governor.budget();
+  BOOST_TEST(recovered > 40 * one_table);
+  BOOST_TEST(recovered <= governor.usage() + 44 * one_table);
+  monitor.poll(); // The same headroom is not given back twice.
+  monitor.poll();
+  BOOST_TEST(governor.budget() == recovered);
+
+  reading.current = 40 * one_table;
+  monitor.poll();
+  BOOST_TEST(governor.budget() == 100 * one_table);
+
+  monitor.start(std::chrono::milliseconds{1});
+  monitor.stop();
+
+  // Exceptions on the background thread are rethrown by stop().
+  std::atomic<bool> polled{false};
+  cet::memory_monitor failing{governor, {}, [&polled]() -> cet::memory_reading {
+                                polled = true;
+                                throw std::runtime_error{"No reading"};
+                              }};
+  failing.start(std::chrono::milliseconds{1});
+  while (not polled) {
+    std::this_thread::yield();
+  }
+  BOOST_CHECK_THROW(failing.stop(), std::runtime_error);
+  failing.stop(); // Already rethrown
+
+  BOOST_CHECK_EXCEPTION(
+    (cet::memory_monitor{governor, {0.9, 0.8}}), cet::exception, [](auto const& e) {
+      return std::regex_match(e.category(), std::regex{"Cache configuration error."});
+    });
+
+  // The default source reads the process's own memory.
+  BOOST_TEST(cet::process_memory().current > 0ull);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+#ifndef cetlib_dense_table_h
+#define cetlib_dense_table_h
+
+// ===================================================================
+// Dense keys
+//
+// A key type is dense if its values are small, non-negative integers
+// that are mostly contiguous--e.g. run numbers, channel IDs or crate
+// indices.  A type is declared dense by specializing the is_dense_key
+// trait:
+//
+//   enum class crate_id : unsigned {};
+//   template <>
+//   struct cet::is_dense_key<crate_id> : std::true_type {};
+//
+// The index of a dense key is obtained with static_cast<std::size_t>.
+// For caches with dense keys, lookups are resolved through a
+// dense_table (see below) instead of a hash map.
+//
+// The dense_table class template is a segmented, growable array of
+// atomic slots, indexed directly by key.  Segment s holds the 2^s
+// slots with indices [2^s - 1, 2^(s+1) - 1); segments are allocated on
+// first use and never move, so that a lookup amounts to loading the
+// segment pointer and the slot.  Slots are never removed.
+//
+// A table holds at most dense_table<T>::capacity (2^24 - 1) slots, so
+// dense keys must be smaller than 16,777,215.  Since the segment for a
+// key is allocated in full, a single key close to that limit reserves
+// 64 MiB; keys that are not mostly contiguous from zero are better
+// served by hashing.
+//
+// N.B. The dense_table class template is not intended to be
+//      user-facing.
+// ===================================================================
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cet {
+
+  template <typename K>
+  struct is_dense_key : std::false_type {};
+
+  template <typename K>
+  constexpr bool is_dense_key_v = is_dense_key<K>::value;
+
+  namespace detail {
+
+    template <typename T>
+    class dense_table {
+    public:
+      using slot_type = std::atomic<T const*>;
+
+      dense_table() = default;
+      dense_table(dense_table const&) = delete;
+      dense_table& operator=(dense_table const&) = delete;
+
+      ~dense_table()
+      {
+        for (auto& segment : segments_) {
+          delete[] segment.load();
+        }
+      }
+
+      static constexpr std::size_t max_segments = 24;
+      static constexpr std::size_t capacity = (std::size_t{1} << max_segments) - 1;
+
+      // Returns nullptr if the slot has never been created.
+      slot_type*
+      find(std::size_t const i) const noexcept
+      {
+        if (i >= capacity) {
+          return nullptr;
+        }
+        auto const [s, offset] = locate_(i);
+        auto* segment = segments_[s].load(std::memory_order_acquire);
+        return segment ? segment + offset : nullptr;
+      }
+
+      slot_type&
+      slot(std::size_t const i)
+      {
+        if (i >= capacity) {
+          throw std::length_error("Dense key exceeds the capacity of the dense table.");
+        }
+        auto const [s, offset] = locate_(i);
+        auto* segment = segments_[s].load(std::memory_order_acquire);
+        if (segment == nullptr) {
+          auto* fresh = new slot_type[std::size_t{1} << s]{};
+          if (segments_[s].compare_exchange_strong(segment, fresh)) {
+            segment = fresh;
+          }
+          else {
+            delete[] fresh; // Another thread allocated the segment first.
+          }
+        }
+        return segment[offset];
+      }
+
+      template <typename F>
+      void
+      for_each(F f) const
+      {
+        for (std::size_t s{}; s != max_segments; ++s) {
+          if (auto* segment = segments_[s].load()) {
+            for (std::size_t j{}, n = std::size_t{1} << s; j != n; ++j) {
+              f(segment[j]);
+            }
+          }
+        }
+      }
+
+    private:
+      // Must be called with i < capacity.
+      static std::pair<std::size_t, std::size_t>
+      locate_(std::size_t const i) noexcept
+      {
+        auto const n = i + 1;
+        std::size_t s{};
+        while ((n >> (s + 1)) != 0) {
+          ++s;
+        }
+        return {s, n - (std::size_t{1} << s)};
+      }
+
+      std::array<std::atomic<slot_type*>, max_segments> segments_{};
+    };
+  }
+}
+
+#endif /* cetlib_dense_table_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,167 @@
+#ifndef cetlib_epoch_domain_h
+#define cetlib_epoch_domain_h
+
+// ===================================================================
+// The epoch_domain class provides epoch-based reclamation for objects
+// that are read without holding any reference count or lock.
+//
+// A reader announces itself by creating an epoch_guard, which records
+// the domain's current epoch in one of the domain's reader slots.
+// Each slot occupies its own cache line, and a thread preferentially
+// uses the same slot, so that entering and leaving a read section
+// writes only to memory that is not shared with other readers.  There
+// are max_readers slots: try_enter() fails if all of them are taken,
+// whereas enter() waits for one to be released, which is appropriate
+// only if all read sections of the domain are short.
+//
+// A writer first unpublishes an object (so that no new reader can
+// find it), and then retires it.  Retiring advances the epoch.  The
+// retired object is destroyed by a subsequent reclaim() call once
+// every reader that might still observe it has left its read
+// section--i.e. once no slot holds an epoch at or before the one at
+// which the object was retired.
+//
+// An epoch_guard must not outlive the domain that created it, and it
+// may be used only by the thread that created it.
+//
+// N.B. The epoch_domain class is not intended to be user-facing.
+// ===================================================================
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cet {
+
+  namespace detail {
+    class epoch_domain;
+  }
+
+  class epoch_guard {
+  public:
+    epoch_guard(epoch_guard const&) = delete;
+    epoch_guard& operator=(epoch_guard const&) = delete;
+    epoch_guard(epoch_guard&& other) noexcept
+      : domain_{std::exchange(other.domain_, nullptr)}, slot_{std::exchange(other.slot_, nullptr)}
+    {}
+    epoch_guard& operator=(epoch_guard&&) = delete;
+
+    ~epoch_guard()
+    {
+      if (slot_ != nullptr) {
+        slot_->store(0u);
+      }
+    }
+
+    detail::epoch_domain const*
+    domain() const noexcept
+    {
+      return domain_;
+    }
+
+  private:
+    friend class detail::epoch_domain;
+    epoch_guard(detail::epoch_domain const* domain, std::atomic<std::uint64_t>* slot) noexcept
+      : domain_{domain}, slot_{slot}
+    {}
+
+    detail::epoch_domain const* domain_;
+    std::atomic<std::uint64_t>* slot_;
+  };
+
+  namespace detail {
+
+    class epoch_domain {
+    public:
+      static constexpr std::size_t max_readers = 128;
+
+      // Returns std::nullopt if all slots are taken.
+      std::optional<epoch_guard>
+      try_enter() const
+      {
+        // Prefer the same slot for a given thread.
+        static thread_local std::size_t const preferred =
+          std::hash<std::thread::id>{}(std::this_thread::get_id());
+        for (std::size_t i{}; i != max_readers; ++i) {
+          auto& slot = slots_[(preferred + i) % max_readers].epoch;
+          auto idle = slot.load();
+          if (idle == 0u and slot.compare_exchange_strong(idle, epoch_.load())) {
+            return epoch_guard{this, &slot};
+          }
+        }
+        return std::nullopt;
+      }
+
+      epoch_guard
+      enter() const
+      {
+        while (true) {
+          if (auto guard = try_enter()) {
+            return std::move(*guard);
+          }
+          std::this_thread::yield();
+        }
+      }
+
+      // The object must already be unreachable for new readers.
+      void
+      retire(std::shared_ptr<void const> object)
+      {
+        std::lock_guard lock{mutex_};
+        retired_.emplace_back(epoch_.fetch_add(1), std::move(object));
+      }
+
+      // Destroys all retired objects that no reader can still observe.
+      void
+      reclaim()
+      {
+        std::lock_guard lock{mutex_};
+        if (std::empty(retired_)) {
+          return;
+        }
+        auto oldest_reader = -1ull;
+        for (auto const& slot : slots_) {
+          if (auto const e = slot.epoch.load(); e != 0u) {
+            oldest_reader = std::min<std::uint64_t>(oldest_reader, e);
+          }
+        }
+        // Objects are retired in order of increasing epoch.
+        auto const e = std::find_if(begin(retired_), end(retired_), [oldest_reader](auto const& r) {
+          return r.first >= oldest_reader;
+        });
+        retired_.erase(begin(retired_), e);
+      }
+
+      std::size_t
+      retired() const
+      {
+        std::lock_guard lock{mutex_};
+        return std::size(retired_);
+      }
+
+    private:
+      struct alignas(64) reader_slot {
+        std::atomic<std::uint64_t> epoch{0u};
+      };
+
+      std::atomic<std::uint64_t> epoch_{1u}; // Zero denotes an idle slot.
+      mutable std::array<reader_slot, max_readers> slots_{};
+      mutable std::mutex mutex_;
+      std::vector<std::pair<std::uint64_t, std::shared_ptr<void const>>> retired_;
+    };
+  }
+}
+
+#endif /* cetlib_epoch_domain_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,136 @@
+// ========================================================================
+// Read-path benchmark
+//
+// Compares the lookups of a concurrent_cache with the default,
+// accessor-based read path to those of caches constructed with the
+// cache_option::optimistic_reads and cache_option::epoch_protection
+// options.  Each thread issues a mix of lookups over a small set of hot
+// keys and of emplacements of new keys, which are dropped periodically:
+//
+//   read_path_benchmark [threads [operations-per-thread [percent-reads [hot-keys]]]]
+//
+// The defaults are the number of hardware threads, 400000 operations
+// per thread, 95% reads and 64 hot keys.  With a single hot key, all
+// lookups contend for the same entry.  The wall-clock time of each
+// variant is printed, together with the number of lookups that did
+// not find the expected value (which should be zero).
+//
+// On a single-core host, neither variant is a win over the accessor
+// path.  With 8 threads and 64 hot keys, the optimistic reads took
+// 2.80 s and the epoch-protected reads 2.94 s, against 2.30 s for the
+// accessor path.  With a single hot key, they took 2.82 s and 2.73 s,
+// against 2.43 s.  Such a host measures the overhead of each read
+// path, but not its scalability under contention, which requires
+// several cores.
+
+#include "cetlib/concurrent_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+  struct settings {
+    unsigned threads;
+    unsigned operations;
+    unsigned percent_reads;
+    unsigned hot_keys;
+  };
+
+  // Lookups are made through 'read', which returns true if it found
+  // the expected value for the key.  The hot keys stay pinned for the
+  // duration of the run, so that only the emplaced keys are dropped.
+  template <typename Cache, typename Read>
+  void
+  run(std::string const& name, Cache& cache, settings const& s, Read read)
+  {
+    std::vector<cet::cache_handle<unsigned>> hot;
+    for (unsigned k{}; k != s.hot_keys; ++k) {
+      hot.push_back(cache.emplace(k, k));
+    }
+
+    std::atomic<unsigned> misses{};
+    std::atomic<unsigned> next_key{s.hot_keys};
+    auto const start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t{}; t != s.threads; ++t) {
+      threads.emplace_back([&, t] {
+        std::minstd_rand engine{t + 1};
+        std::uniform_int_distribution<unsigned> percent{0, 99};
+        std::uniform_int_distribution<unsigned> hot_key{0, s.hot_keys - 1};
+        for (unsigned i{}; i != s.operations; ++i) {
+          if (percent(engine) < s.percent_reads) {
+            auto const k = hot_key(engine);
+            if (not read(cache, k)) {
+              ++misses;
+            }
+          }
+          else {
+            auto const k = next_key++;
+            cache.emplace(k, k);
+          }
+          if (i % 10'000 == 0) {
+            cache.drop_unused();
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << elapsed.count() << " s (" << misses << " misses)\n";
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  settings s{std::max(std::thread::hardware_concurrency(), 1u), 400'000, 95, 64};
+  if (argc > 1) {
+    s.threads = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    s.operations = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    s.percent_reads = std::atoi(argv[3]);
+  }
+  if (argc > 4) {
+    s.hot_keys = std::max(std::atoi(argv[4]), 1);
+  }
+  std::cout << s.threads << " thread(s), " << s.operations << " operations per thread, "
+            << s.percent_reads << "% reads, " << s.hot_keys << " hot key(s)\n";
+
+  // As for a short-lived lookup, the value is read while the handle
+  // pins it, after which the handle is released.
+  auto read_handle = [](auto& cache, unsigned const k) {
+    auto const h = cache.at(k);
+    return h and *h == k;
+  };
+
+  using cache_t = cet::concurrent_cache<unsigned, unsigned>;
+  {
+    cache_t cache;
+    run("accessor  ", cache, s, read_handle);
+  }
+  {
+    cache_t cache{cet::cache_option::optimistic_reads};
+    run("optimistic", cache, s, read_handle);
+  }
+  {
+    cache_t cache{cet::cache_option::epoch_protection};
+    run("epoch     ", cache, s, [](cache_t& c, unsigned const k) {
+      auto const guard = c.read_guard();
+      auto const v = c.at(k, guard);
+      return v and *v == k;
+    });
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef cetlib_hash_combine_h
+#define cetlib_hash_combine_h
+
+// ===================================================================
+// Hashing facilities for composite keys
+//
+// The std::hash specializations of the standard library are typically
+// the identity for integral types, and combining such hashes with XOR
+// (or with weakly mixing formulas) yields many collisions for keys
+// whose components are correlated--e.g. the intervals [x, x) all hash
+// to zero, and [a, b) collides with [b, a).  The facilities below
+// instead pass each component's hash through a full-avalanche mixing
+// function (the 64-bit finalizer of SplitMix64) before folding it
+// into the running hash:
+//
+//   std::size_t seed{};
+//   seed = hash_combine(seed, std::hash<A>{}(a));
+//   seed = hash_combine(seed, std::hash<B>{}(b));
+//
+// or, equivalently,
+//
+//   auto const h = hash_values(a, b);
+//
+// The combination is order-dependent, so that (a, b) and (b, a) hash
+// differently.
+// ===================================================================
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace cet {
+
+  constexpr std::uint64_t
+  hash_mix(std::uint64_t x) noexcept
+  {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+  }
+
+  constexpr std::size_t
+  hash_combine(std::size_t const seed, std::size_t const h) noexcept
+  {
+    return static_cast<std::size_t>(hash_mix(seed + 0x9e3779b97f4a7c15ull + hash_mix(h)));
+  }
+
+  template <typename... Ts>
+  std::size_t
+  hash_values(Ts const&... ts)
+  {
+    std::size_t seed{};
+    ((seed = hash_combine(seed, std::hash<Ts>{}(ts))), ...);
+    return seed;
+  }
+}
+
+#endif /* cetlib_hash_combine_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,248 @@
+#ifndef cetlib_hashed_key_h
+#define cetlib_hashed_key_h
+
+// ===================================================================
+// The concurrent_cache stores each key together with its hash, so
+// that a key is hashed once per operation, irrespective of the
+// number of internal maps that are consulted.
+//
+// Users can additionally hash a key once and use it for many lookups
+// by wrapping it in a prehashed_key:
+//
+//   concurrent_cache<std::string, V> cache;
+//   prehashed_key const key{std::string{"Alice"}};
+//   for (...) {
+//     auto h = cache.at(key); // No hashing, no allocation
+//   }
+//
+// Caches with std::basic_string keys also support heterogeneous
+// lookup with any type that is convertible to the corresponding
+// std::basic_string_view (e.g. std::string_view or const char*):
+//
+//   auto h = cache.at("Alice"); // No temporary std::string
+//
+// Keys are hashed with tbb::tbb_hash_compare<K>, except for string
+// keys, which are hashed through their string-view representation so
+// that heterogeneous lookups yield the same hash, and for dense keys
+// (see dense_table.h), whose index serves as their hash.
+// ===================================================================
+
+#include "cetlib/dense_table.h"
+
+#include "tbb/concurrent_hash_map.h"
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace cet {
+
+  namespace detail {
+
+    // The view of a key is the representation through which it is
+    // hashed and compared.
+    template <typename K>
+    struct key_traits {
+      using view_type = K const*;
+      static constexpr bool heterogeneous = false;
+
+      static view_type
+      view(K const& k) noexcept
+      {
+        return &k;
+      }
+      static std::size_t
+      hash(view_type const v)
+      {
+        if constexpr (is_dense_key_v<K>) {
+          return static_cast<std::size_t>(*v);
+        }
+        else {
+          return tbb::tbb_hash_compare<K>{}.hash(*v);
+        }
+      }
+      static bool
+      equal(view_type const a, view_type const b)
+      {
+        return tbb::tbb_hash_compare<K>{}.equal(*a, *b);
+      }
+      static K
+      materialize(view_type const v)
+      {
+        return *v;
+      }
+    };
+
+    template <typename C, typename Tr, typename A>
+    struct key_traits<std::basic_string<C, Tr, A>> {
+      using view_type = std::basic_string_view<C, Tr>;
+      static constexpr bool heterogeneous = true;
+
+      static view_type
+      view(std::basic_string<C, Tr, A> const& k) noexcept
+      {
+        return k;
+      }
+      static std::size_t
+      hash(view_type const v)
+      {
+        return std::hash<view_type>{}(v);
+      }
+      static bool
+      equal(view_type const a, view_type const b) noexcept
+      {
+        return a == b;
+      }
+      static std::basic_string<C, Tr, A>
+      materialize(view_type const v)
+      {
+        return std::basic_string<C, Tr, A>{v};
+      }
+    };
+
+    template <typename K, typename T>
+    constexpr bool is_heterogeneous_key_v =
+      key_traits<K>::heterogeneous and not std::is_same_v<std::decay_t<T>, K> and
+      std::is_convertible_v<T const&, typename key_traits<K>::view_type>;
+
+    // A hashed_key either owns its key, or it borrows the view of a
+    // key for the duration of a lookup.  Copying a hashed_key always
+    // yields an owning key; the keys stored in the cache's maps are
+    // therefore owning keys.
+    template <typename K>
+    class hashed_key {
+      using traits = key_traits<K>;
+
+    public:
+      using view_type = typename traits::view_type;
+
+      explicit hashed_key(K key) : owned_{std::move(key)}, view_{traits::view(*owned_)}
+      {
+        hash_ = traits::hash(view_);
+      }
+
+      hashed_key(K key, std::size_t const hash)
+        : owned_{std::move(key)}, view_{traits::view(*owned_)}, hash_{hash}
+      {}
+
+      static hashed_key
+      borrow(view_type const view)
+      {
+        return hashed_key{view, traits::hash(view)};
+      }
+
+      static hashed_key
+      borrow(view_type const view, std::size_t const hash) noexcept
+      {
+        return hashed_key{view, hash};
+      }
+
+      hashed_key(hashed_key const& other)
+        : owned_{other.owned_ ? *other.owned_ : traits::materialize(other.view_)}
+        , view_{traits::view(*owned_)}
+        , hash_{other.hash_}
+      {}
+
+      hashed_key(hashed_key&& other)
+        : owned_{other.owned_ ? std::move(*other.owned_) : traits::materialize(other.view_)}
+        , view_{traits::view(*owned_)}
+        , hash_{other.hash_}
+      {}
+
+      hashed_key& operator=(hashed_key const&) = delete;
+      hashed_key& operator=(hashed_key&&) = delete;
+
+      // Only meaningful for owning keys.
+      K const&
+      key() const noexcept
+      {
+        return *owned_;
+      }
+
+      view_type
+      view() const noexcept
+      {
+        return view_;
+      }
+
+      std::size_t
+      hash() const noexcept
+      {
+        return hash_;
+      }
+
+    private:
+      hashed_key(view_type const view, std::size_t const hash) noexcept : view_{view}, hash_{hash}
+      {}
+
+      std::optional<K> owned_{};
+      view_type view_;
+      std::size_t hash_;
+    };
+
+    // For tbb::concurrent_hash_map
+    template <typename K>
+    struct hashed_key_compare {
+      std::size_t
+      hash(hashed_key<K> const& k) const noexcept
+      {
+        return k.hash();
+      }
+      bool
+      equal(hashed_key<K> const& a, hashed_key<K> const& b) const
+      {
+        return a.hash() == b.hash() and key_traits<K>::equal(a.view(), b.view());
+      }
+    };
+
+    // For tbb::concurrent_unordered_map
+    template <typename K>
+    struct hashed_key_hash {
+      std::size_t
+      operator()(hashed_key<K> const& k) const noexcept
+      {
+        return k.hash();
+      }
+    };
+
+    template <typename K>
+    struct hashed_key_equal {
+      bool
+      operator()(hashed_key<K> const& a, hashed_key<K> const& b) const
+      {
+        return hashed_key_compare<K>{}.equal(a, b);
+      }
+    };
+  }
+
+  template <typename K>
+  class prehashed_key {
+  public:
+    explicit prehashed_key(K key) : key_{std::move(key)} {}
+
+    K const&
+    key() const noexcept
+    {
+      return key_.key();
+    }
+
+    std::size_t
+    hash() const noexcept
+    {
+      return key_.hash();
+    }
+
+  private:
+    detail::hashed_key<K> key_;
+  };
+}
+
+#endif /* cetlib_hashed_key_h */
+
+// Local Variables:
+// mode: c++
+// End:
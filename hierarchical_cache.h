@@ -0,0 +1,120 @@
+#ifndef cetlib_hierarchical_cache_h
+#define cetlib_hierarchical_cache_h
+
+// ===================================================================
+// The hierarchical_cache class template composes several concurrent
+// caches that hold values of the same type, but at different
+// granularities.  The levels are specified from the finest to the
+// coarsest (e.g.):
+//
+//   hierarchical_cache<Calibration, event_range, event_range, event_range>
+//     cache{{2, 1, 1}}; // Per-level retention (subrun, run, period)
+//
+// The entry_for(t) call first consults the finest level; if no entry
+// of that level supports t, the next-coarser level is consulted, and
+// so on.  Constants that are valid for an entire run can thus be
+// emplaced once in a coarse level, instead of once per subrun in a
+// finer level:
+//
+//   cache.emplace<1>(run_range, run_constants);
+//   cache.emplace<0>(subrun_range, subrun_constants);
+//   auto h = cache.entry_for(event); // Subrun constants if available,
+//                                    // otherwise the run constants
+//
+// Each level has its own retention count, which is applied to that
+// level by the drop_unused() call.  The individual levels can be
+// accessed through the level<I>() member functions.
+// ===================================================================
+
+#include "cetlib/cache_handle.h"
+#include "cetlib/concurrent_cache.h"
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+namespace cet {
+
+  template <typename V, typename... Keys>
+  class hierarchical_cache {
+    static_assert(sizeof...(Keys) > 0, "A hierarchical cache requires at least one level.");
+
+  public:
+    static constexpr std::size_t depth = sizeof...(Keys);
+    using handle = cache_handle<V>;
+    using retention_t = std::array<std::size_t, depth>;
+
+    hierarchical_cache() = default;
+    explicit hierarchical_cache(retention_t const& retention) : retention_{retention} {}
+
+    template <std::size_t I>
+    auto&
+    level() noexcept
+    {
+      return std::get<I>(levels_);
+    }
+
+    template <std::size_t I>
+    auto const&
+    level() const noexcept
+    {
+      return std::get<I>(levels_);
+    }
+
+    template <std::size_t I>
+    using key_t = std::tuple_element_t<I, std::tuple<Keys...>>;
+
+    template <std::size_t I, typename U = V>
+    handle
+    emplace(key_t<I> const& k, U&& value)
+    {
+      return level<I>().emplace(k, std::forward<U>(value));
+    }
+
+    template <typename T>
+    handle
+    entry_for(T const& t) const
+    {
+      return entry_for_<0>(t);
+    }
+
+    void
+    drop_unused()
+    {
+      drop_unused_(std::make_index_sequence<depth>{});
+    }
+
+  private:
+    template <std::size_t I, typename T>
+    handle
+    entry_for_(T const& t) const
+    {
+      if (auto h = level<I>().entry_for(t)) {
+        return h;
+      }
+      if constexpr (I + 1 != depth) {
+        return entry_for_<I + 1>(t);
+      }
+      else {
+        return handle{};
+      }
+    }
+
+    template <std::size_t... I>
+    void
+    drop_unused_(std::index_sequence<I...>)
+    {
+      (level<I>().drop_unused_but_last(retention_[I]), ...);
+    }
+
+    retention_t retention_{};
+    std::tuple<concurrent_cache<Keys, V>...> levels_;
+  };
+}
+
+#endif /* cetlib_hierarchical_cache_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,168 @@
+#ifndef cetlib_interval_h
+#define cetlib_interval_h
+
+// ====================================================================
+// Interval keys for the concurrent cache
+//
+// The interval class template represents the half-open interval
+// [begin, end) over any totally ordered point type.  It satisfies the
+// interval-key interface described in concurrent_cache.h, so that a
+// cache keyed by an interval supports the entry_for(point) interface
+// (e.g.):
+//
+//   concurrent_cache<event_range, V> cache;
+//   cache.emplace(event_range{{1, 0, 0}, {1, 4, 0}}, ...);
+//   auto h = cache.entry_for(event_id{1, 2, 15});
+//
+// Two interval types are provided:
+//
+//   - event_range: intervals of (run, subrun, event) identifiers,
+//     which are ordered lexicographically.  A range covering all
+//     events of run r is {{r, 0, 0}, {r + 1, 0, 0}}.
+//
+//   - timestamp_range: intervals of 64-bit timestamps.
+// ====================================================================
+
+#include "cetlib/hash_combine.h"
+
+#include "tbb/concurrent_hash_map.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <tuple>
+#include <utility>
+
+namespace cet {
+
+  struct event_id {
+    std::uint32_t run;
+    std::uint32_t subrun;
+    std::uint32_t event;
+  };
+
+  inline bool
+  operator<(event_id const& a, event_id const& b) noexcept
+  {
+    return std::tie(a.run, a.subrun, a.event) < std::tie(b.run, b.subrun, b.event);
+  }
+
+  inline bool
+  operator==(event_id const& a, event_id const& b) noexcept
+  {
+    return a.run == b.run and a.subrun == b.subrun and a.event == b.event;
+  }
+
+  inline bool
+  operator!=(event_id const& a, event_id const& b) noexcept
+  {
+    return not(a == b);
+  }
+
+  inline bool
+  operator<=(event_id const& a, event_id const& b) noexcept
+  {
+    return not(b < a);
+  }
+
+  inline std::ostream&
+  operator<<(std::ostream& os, event_id const& id)
+  {
+    return os << id.run << ':' << id.subrun << ':' << id.event;
+  }
+
+  template <typename T>
+  class interval {
+  public:
+    using point_type = T;
+
+    interval(T begin, T end) : begin_{std::move(begin)}, end_{std::move(end)} {}
+
+    T const&
+    begin() const noexcept
+    {
+      return begin_;
+    }
+
+    T const&
+    end() const noexcept
+    {
+      return end_;
+    }
+
+    bool
+    supports(T const& value) const noexcept
+    {
+      return not(value < begin_) and value < end_;
+    }
+
+    bool
+    operator<(interval const& other) const noexcept
+    {
+      return std::tie(begin_, end_) < std::tie(other.begin_, other.end_);
+    }
+
+    bool
+    operator==(interval const& other) const noexcept
+    {
+      return begin_ == other.begin_ and end_ == other.end_;
+    }
+
+  private:
+    T begin_;
+    T end_;
+  };
+
+  template <typename T>
+  std::ostream&
+  operator<<(std::ostream& os, interval<T> const& i)
+  {
+    return os << '[' << i.begin() << ", " << i.end() << ')';
+  }
+
+  using event_range = interval<event_id>;
+  using timestamp_range = interval<std::uint64_t>;
+}
+
+namespace std {
+  template <>
+  struct hash<cet::event_id> {
+    std::size_t
+    operator()(cet::event_id const& id) const
+    {
+      return cet::hash_values(id.run, id.subrun, id.event);
+    }
+  };
+
+  template <typename T>
+  struct hash<cet::interval<T>> {
+    std::size_t
+    operator()(cet::interval<T> const& i) const
+    {
+      return cet::hash_values(i.begin(), i.end());
+    }
+  };
+}
+
+namespace tbb {
+  template <typename T>
+  struct tbb_hash_compare<cet::interval<T>> {
+    std::size_t
+    hash(cet::interval<T> const& i) const
+    {
+      return std::hash<cet::interval<T>>{}(i);
+    }
+
+    bool
+    equal(cet::interval<T> const& lhs, cet::interval<T> const& rhs) const
+    {
+      return lhs == rhs;
+    }
+  };
+}
+
+#endif /* cetlib_interval_h */
+
+// Local Variables:
+// mode: c++
+// End:
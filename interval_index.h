@@ -0,0 +1,312 @@
+#ifndef cetlib_interval_index_h
+#define cetlib_interval_index_h
+
+// ===================================================================
+// The interval_index class template provides the ordered index used
+// by the concurrent_cache to implement entry_for(...) for interval
+// keys (see concurrent_cache.h), and to find the neighbors of an
+// interval when coalescing, without scanning all cache entries.
+//
+// The keys are stored in a vector sorted by (begin, end).  The index
+// also keeps track of the number of consecutive keys that overlap.
+// As long as there are no such overlaps, the key that supports a
+// given point is found with a single binary search.  Otherwise, all
+// keys that begin at or before the point are checked.
+//
+// Lookups may be given a hint: the position of a previous match,
+// together with the version of the index at the time of that match.
+// If the index has not changed since, the search proceeds forward
+// from the hinted position, which is amortized O(1) for monotonically
+// increasing points.
+//
+// The index is copy-on-write: each insertion or erasure builds a new,
+// immutable snapshot of the keys and publishes it atomically.  Readers
+// traverse whichever snapshot they loaded without taking any lock;
+// superseded snapshots are reclaimed once no reader can observe them
+// (see epoch_domain.h).  Writers are serialized among themselves.
+// Key insertions are expected to be rare compared to lookups.
+//
+// N.B. This is not intended to be user-facing.
+// ===================================================================
+
+#include "cetlib/epoch_domain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cet::detail {
+
+  template <typename T, typename = void>
+  struct is_interval_key : std::false_type {};
+
+  template <typename T>
+  struct is_interval_key<
+    T,
+    std::void_t<decltype(T{std::declval<T const&>().begin(), std::declval<T const&>().end()}),
+                decltype(std::declval<T const&>().supports(std::declval<T const&>().begin()))>>
+    : std::true_type {};
+
+  template <typename T>
+  constexpr bool is_interval_key_v = is_interval_key<T>::value;
+
+  template <typename K>
+  using interval_point_t = std::decay_t<decltype(std::declval<K const&>().begin())>;
+
+  // Placeholder for caches whose keys are not intervals.
+  struct no_interval_index {};
+
+  struct index_hint {
+    std::size_t version{-1ull};
+    std::size_t position{};
+  };
+
+  template <typename K>
+  class interval_index {
+  public:
+    using point_type = interval_point_t<K>;
+
+    interval_index() = default;
+    interval_index(interval_index const&) = delete;
+    interval_index& operator=(interval_index const&) = delete;
+    ~interval_index() { delete current_.load(); }
+
+    void
+    insert(K const& k)
+    {
+      std::lock_guard lock{writer_mutex_};
+      auto const& keys = current_.load()->keys;
+      auto const it = std::lower_bound(begin(keys), end(keys), k, key_less);
+      if (it != end(keys) and not key_less(k, *it)) {
+        return;
+      }
+      auto next = std::make_unique<snapshot>(*current_.load());
+      auto const pos = static_cast<std::size_t>(it - begin(keys));
+      if (pos != 0 and pos != std::size(next->keys)) {
+        next->overlaps -= next->overlap_at(pos - 1);
+      }
+      next->keys.insert(begin(next->keys) + pos, k);
+      if (pos != 0) {
+        next->overlaps += next->overlap_at(pos - 1);
+      }
+      next->overlaps += next->overlap_at(pos);
+      publish_(std::move(next));
+    }
+
+    void
+    erase(K const& k)
+    {
+      std::lock_guard lock{writer_mutex_};
+      auto const& keys = current_.load()->keys;
+      auto const it = std::lower_bound(begin(keys), end(keys), k, key_less);
+      if (it == end(keys) or key_less(k, *it)) {
+        return;
+      }
+      auto next = std::make_unique<snapshot>(*current_.load());
+      auto const pos = static_cast<std::size_t>(it - begin(keys));
+      if (pos != 0) {
+        next->overlaps -= next->overlap_at(pos - 1);
+      }
+      next->overlaps -= next->overlap_at(pos);
+      next->keys.erase(begin(next->keys) + pos);
+      if (pos != 0 and pos != std::size(next->keys)) {
+        next->overlaps += next->overlap_at(pos - 1);
+      }
+      publish_(std::move(next));
+    }
+
+    // Returns the number of keys that support the point p, up to a
+    // maximum of 2.  If the returned value is not zero, 'match' is set
+    // to one of the supporting keys.
+    unsigned
+    find(point_type const& p, std::optional<K>& match) const
+    {
+      index_hint no_hint;
+      return find(p, match, no_hint);
+    }
+
+    // As above, but the search starts from the hint, which is updated
+    // to refer to the returned match.
+    unsigned
+    find(point_type const& p, std::optional<K>& match, index_hint& hint) const
+    {
+      auto const guard = readers_.enter();
+      auto const& snap = *current_.load();
+      auto const& keys = snap.keys;
+      auto const b = begin(keys);
+      auto const e = end(keys);
+      auto const n_keys = std::size(keys);
+      if (snap.overlaps != 0) {
+        hint = {};
+        unsigned n{};
+        for (auto it = b; it != e and n != 2 and not(p < it->begin()); ++it) {
+          if (it->supports(p)) {
+            match = *it;
+            ++n;
+          }
+        }
+        return n;
+      }
+
+      auto begins_after_p = [](point_type const& p, K const& k) { return p < k.begin(); };
+      std::size_t pos{};
+      if (hint.version == snap.version and hint.position < n_keys and
+          not(p < keys[hint.position].begin())) {
+        // Walk forward a few steps, then resort to a binary search.
+        pos = hint.position;
+        for (unsigned steps{}; pos + 1 != n_keys and not(p < keys[pos + 1].begin()); ++pos) {
+          if (++steps == max_walk) {
+            pos = (std::upper_bound(b + pos, e, p, begins_after_p) - b) - 1;
+            break;
+          }
+        }
+      }
+      else {
+        auto const it = std::upper_bound(b, e, p, begins_after_p);
+        if (it == b) {
+          hint = {};
+          return 0;
+        }
+        pos = (it - b) - 1;
+      }
+
+      hint = {snap.version, pos};
+      auto const& candidate = keys[pos];
+      if (not candidate.supports(p)) {
+        return 0;
+      }
+      match = candidate;
+      return 1;
+    }
+
+    // Changes whenever a key is inserted or erased.
+    std::size_t
+    version() const noexcept
+    {
+      return version_;
+    }
+
+    // Returns all keys that overlap with k.
+    std::vector<K>
+    overlapping(K const& k) const
+    {
+      auto const guard = readers_.enter();
+      auto const& snap = *current_.load();
+      auto const e = std::partition_point(
+        begin(snap.keys), end(snap.keys), [&k](K const& key) { return key.begin() < k.end(); });
+      // Without overlaps, the upper bounds are sorted as well.
+      auto b = begin(snap.keys);
+      if (snap.overlaps == 0) {
+        b = std::partition_point(
+          b, e, [&k](K const& key) { return not(k.begin() < key.end()); });
+      }
+
+      std::vector<K> result;
+      std::copy_if(b, e, std::back_inserter(result), [&k](K const& key) {
+        return k.begin() < key.end();
+      });
+      return result;
+    }
+
+    // Returns the keys that end where k begins, and the keys that
+    // begin where k ends.
+    std::pair<std::vector<K>, std::vector<K>>
+    adjacent(K const& k) const
+    {
+      auto const guard = readers_.enter();
+      auto const& snap = *current_.load();
+      auto const b = begin(snap.keys);
+      auto const e = end(snap.keys);
+      std::pair<std::vector<K>, std::vector<K>> result;
+      auto& [left, right] = result;
+
+      auto const starts_before = [](point_type const& p) {
+        return [&p](K const& key) { return key.begin() < p; };
+      };
+      auto const before_k = std::partition_point(b, e, starts_before(k.begin()));
+      if (snap.overlaps == 0) {
+        // Only the last key that begins before k can end where k begins.
+        if (before_k != b and std::prev(before_k)->end() == k.begin()) {
+          left.push_back(*std::prev(before_k));
+        }
+      }
+      else {
+        std::copy_if(b, before_k, std::back_inserter(left), [&k](K const& key) {
+          return key.end() == k.begin();
+        });
+      }
+
+      for (auto it = std::partition_point(before_k, e, starts_before(k.end()));
+           it != e and it->begin() == k.end();
+           ++it) {
+        right.push_back(*it);
+      }
+      return result;
+    }
+
+    std::size_t
+    size() const
+    {
+      auto const guard = readers_.enter();
+      return std::size(current_.load()->keys);
+    }
+
+  private:
+    struct snapshot {
+      std::vector<K> keys;
+      std::size_t overlaps{};
+      std::size_t version{};
+
+      // Whether the keys at positions i and i+1 overlap.
+      std::size_t
+      overlap_at(std::size_t const i) const
+      {
+        if (i + 1 >= std::size(keys)) {
+          return 0;
+        }
+        return keys[i + 1].begin() < keys[i].end();
+      }
+    };
+
+    static bool
+    key_less(K const& a, K const& b)
+    {
+      if (a.begin() < b.begin()) {
+        return true;
+      }
+      if (b.begin() < a.begin()) {
+        return false;
+      }
+      return a.end() < b.end();
+    }
+
+    // Must be called while holding the writer mutex.
+    void
+    publish_(std::unique_ptr<snapshot> next)
+    {
+      next->version = ++version_;
+      std::shared_ptr<snapshot const> previous{current_.exchange(next.release())};
+      readers_.retire(std::move(previous));
+      readers_.reclaim();
+    }
+
+    static constexpr unsigned max_walk = 4;
+
+    std::mutex writer_mutex_;
+    std::atomic<snapshot const*> current_{new snapshot};
+    std::atomic<std::size_t> version_{};
+    epoch_domain readers_;
+  };
+}
+
+#endif /* cetlib_interval_index_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -1,8 +1,11 @@
 #ifndef cetlib_test_interval_of_validity_h
 #define cetlib_test_interval_of_validity_h
 
+#include "cetlib/hash_combine.h"
+
 #include "tbb/concurrent_hash_map.h"
 
+#include <functional>
 #include <utility>
 
 namespace cet::test {
@@ -13,6 +16,18 @@ namespace cet::test {
 
     interval_of_validity(unsigned int begin, unsigned int end) : range_{begin, end} {}
 
+    unsigned int
+    begin() const noexcept
+    {
+      return range_.first;
+    }
+
+    unsigned int
+    end() const noexcept
+    {
+      return range_.second;
+    }
+
     bool
     supports(unsigned int const value) const noexcept
     {
@@ -32,7 +47,6 @@ namespace cet::test {
     }
 
     friend class std::hash<interval_of_validity>;
-    friend class tbb::tbb_hash_compare<interval_of_validity>;
     friend std::ostream& operator<<(std::ostream&, interval_of_validity const& iov);
 
   private:
@@ -46,39 +60,36 @@ namespace cet::test {
   }
 }
 
+namespace std {
+  template <>
+  struct hash<cet::test::interval_of_validity> {
+    std::size_t
+    operator()(cet::test::interval_of_validity const& iov) const
+    {
+      return cet::hash_values(iov.range_.first, iov.range_.second);
+    }
+  };
+}
+
 namespace tbb {
   template <>
   struct tbb_hash_compare<cet::test::interval_of_validity> {
     std::size_t
     hash(cet::test::interval_of_validity const& iov) const
     {
-      return hasher.hash(iov.range_);
+      return std::hash<cet::test::interval_of_validity>{}(iov);
     }
 
     bool
     equal(cet::test::interval_of_validity const& lhs,
           cet::test::interval_of_validity const& rhs) const
     {
-      return hasher.equal(lhs.range_, rhs.range_);
+      return lhs == rhs;
     }
-
-    tbb_hash_compare<cet::test::interval_of_validity::value_type> hasher;
   };
 
 }
 
-namespace std {
-  template <>
-  struct hash<cet::test::interval_of_validity> {
-    std::size_t
-    operator()(cet::test::interval_of_validity const& iov) const
-    {
-      std::hash<unsigned> hash{};
-      return hash(iov.range_.first) ^ hash(iov.range_.second);
-    }
-  };
-}
-
 #endif /* cetlib_test_interval_of_validity_h */
 
 // Local Variables:
@@ -0,0 +1,102 @@
+#ifndef cetlib_iov_cursor_h
+#define cetlib_iov_cursor_h
+
+// ===================================================================
+// The iov_cursor class template tracks the position of an ordered
+// stream of values (e.g. event numbers or timestamps) within the
+// interval index of a concurrent_cache whose keys are intervals.  A
+// typical use is to create one cursor per schedule:
+//
+//   concurrent_cache<event_range, V> cache;
+//   iov_cursor cursor{cache};
+//   ...
+//   if (auto const& h = cursor.advance_to(event)) {
+//     auto const& value_for_event = *h;
+//     ...
+//   }
+//
+// The cursor keeps the entry for the current interval pinned.  As long
+// as the advanced-to values remain in the current interval, the
+// advance_to call amounts to a check of the interval's bounds.  When
+// the values leave the interval, the search for the next interval
+// proceeds forward from the current position, falling back to a
+// binary search for large jumps or if the index has changed.
+//
+// The returned handle remains valid until the next advance_to or
+// reset call.  A cursor may be used by only one thread at a time.
+//
+// N.B. Because the current entry is pinned, it is not removed by the
+//      cache's drop_unused* functions.  Calling reset() releases it.
+// ===================================================================
+
+#include "cetlib/cache_handle.h"
+#include "cetlib/concurrent_cache.h"
+#include "cetlib/interval_index.h"
+#include "cetlib_except/exception.h"
+
+#include <optional>
+
+namespace cet {
+
+  template <typename K, typename V>
+  class iov_cursor {
+    static_assert(detail::is_interval_key_v<K>,
+                  "An iov_cursor requires a cache whose key type is an interval key.");
+
+  public:
+    using cache_t = concurrent_cache<K, V>;
+    using handle = cache_handle<V>;
+    using point_type = detail::interval_point_t<K>;
+
+    explicit iov_cursor(cache_t const& cache) : cache_{&cache} {}
+
+    handle const&
+    advance_to(point_type const& p)
+    {
+      auto const& index = cache_->index_;
+      if (current_ and hint_.version == index.version() and key_->supports(p)) {
+        return current_;
+      }
+
+      std::optional<K> match;
+      auto const n = index.find(p, match, hint_);
+      if (n == 0u) {
+        reset();
+        return current_;
+      }
+      if (n > 1u) {
+        reset();
+        throw cet::exception("Data retrieval error.") << "More than one key match.";
+      }
+      if (current_ and *key_ == *match) {
+        return current_;
+      }
+
+      key_ = std::move(match);
+      current_ = cache_->at(*key_);
+      return current_;
+    }
+
+    void
+    reset()
+    {
+      current_.invalidate();
+      key_.reset();
+    }
+
+  private:
+    cache_t const* cache_;
+    detail::index_hint hint_{};
+    std::optional<K> key_{};
+    handle current_{};
+  };
+
+  template <typename K, typename V>
+  iov_cursor(concurrent_cache<K, V> const&) -> iov_cursor<K, V>;
+}
+
+#endif /* cetlib_iov_cursor_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,132 @@
+#ifndef cetlib_key_interner_h
+#define cetlib_key_interner_h
+
+// ===================================================================
+// A key_interner maps strings to compact, dense IDs.  Each distinct
+// string is stored once and is assigned the next available ID:
+//
+//   key_interner interner;
+//   concurrent_cache<interned_key, V> cache;
+//
+//   auto const alice = interner.intern("Alice"); // Hashes "Alice" once
+//   cache.emplace(alice, ...);
+//   for (...) {
+//     auto h = cache.at(alice);                  // No string hashing
+//   }
+//   interner.key(alice);                         // "Alice"
+//
+// The interned_key type is a dense key (see dense_table.h), so that a
+// cache keyed by interned_key compares integers and resolves its
+// lookups by direct indexing.  Callers are encouraged to intern a
+// string once and to retain the returned ID for repeated lookups.
+//
+// The intern(...) function returns the existing ID of a string that
+// has already been interned; find(...) returns an empty optional
+// instead of creating a new ID.  IDs are never reclaimed, and they are
+// meaningful only for the interner that produced them.  As for any
+// dense key, IDs are bounded by the capacity of the dense table, so an
+// interner holds at most 16,777,215 strings.
+//
+// All member functions may be called concurrently.
+// ===================================================================
+
+#include "cetlib/dense_table.h"
+#include "cetlib/hashed_key.h"
+#include "cetlib_except/exception.h"
+
+#include "tbb/concurrent_hash_map.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+
+namespace cet {
+
+  enum class interned_key : std::uint32_t {};
+
+  template <>
+  struct is_dense_key<interned_key> : std::true_type {};
+
+  template <typename S = std::string>
+  class key_interner {
+    using key_type = detail::hashed_key<S>;
+    using view_type = typename key_type::view_type;
+    using ids_t = tbb::concurrent_hash_map<key_type, interned_key, detail::hashed_key_compare<S>>;
+
+  public:
+    key_interner() = default;
+    key_interner(key_interner const&) = delete;
+    key_interner& operator=(key_interner const&) = delete;
+
+    interned_key
+    intern(view_type const s)
+    {
+      auto const probe = key_type::borrow(s);
+      if (auto id = find_(probe)) {
+        return *id;
+      }
+      typename ids_t::accessor a;
+      if (ids_.insert(a, probe)) {
+        auto const id = next_.fetch_add(1);
+        if (id >= detail::dense_table<S>::capacity) {
+          ids_.erase(a);
+          throw cet::exception("Key interning error.") << "The interner has run out of IDs.";
+        }
+        a->second = interned_key{static_cast<std::uint32_t>(id)};
+        // The string is owned by the node of the ID map, which never
+        // moves; the reverse table refers to it.  Other threads cannot
+        // observe the ID until the accessor is released.
+        strings_.slot(id).store(&a->first.key(), std::memory_order_release);
+      }
+      return a->second;
+    }
+
+    std::optional<interned_key>
+    find(view_type const s) const
+    {
+      return find_(key_type::borrow(s));
+    }
+
+    S const&
+    key(interned_key const id) const
+    {
+      auto* slot = strings_.find(static_cast<std::size_t>(id));
+      auto const* s = slot ? slot->load(std::memory_order_acquire) : nullptr;
+      if (s == nullptr) {
+        throw cet::exception("Invalid interned key.")
+          << "The ID " << static_cast<std::uint32_t>(id) << " was not issued by this interner.";
+      }
+      return *s;
+    }
+
+    std::size_t
+    size() const
+    {
+      return ids_.size();
+    }
+
+  private:
+    std::optional<interned_key>
+    find_(key_type const& probe) const
+    {
+      typename ids_t::const_accessor a;
+      if (ids_.find(a, probe)) {
+        return a->second;
+      }
+      return std::nullopt;
+    }
+
+    ids_t ids_;
+    detail::dense_table<S> strings_;
+    std::atomic<std::uint64_t> next_{};
+  };
+}
+
+#endif /* cetlib_key_interner_h */
+
+// Local Variables:
+// mode: c++
+// End:
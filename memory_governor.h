@@ -0,0 +1,223 @@
+#ifndef cetlib_memory_governor_h
+#define cetlib_memory_governor_h
+
+// ===================================================================
+// A memory_governor enforces one memory budget across any number of
+// concurrent caches.  Caches join the governor with a weight:
+//
+//   memory_governor governor{2'000'000'000}; // Bytes
+//   concurrent_cache<K1, V1> geometry;
+//   concurrent_cache<K2, V2> calibrations;
+//   geometry.join(governor, 2.);             // Twice the share
+//   calibrations.join(governor);             // Weight of 1
+//
+// Each cache reports the estimated memory of its entries (see
+// cache_value_size.h) to the governor.  Whenever an emplacement makes
+// the total exceed the budget, the governor reclaims memory from the
+// cache whose usage is largest relative to its weight, down to the
+// usage of the next-largest one, and so on, until the total is
+// within budget.  A cache thus yields its cold entries to another
+// cache that grows only if it exceeds its weighted share.
+//
+// Memory is reclaimed by dropping unused entries, oldest first,
+// irrespective of any retention requested by drop_unused_but_last(n).
+// Entries that are referred to by handles are never dropped, so the
+// budget may be exceeded if too many entries are in use.  Once memory
+// can no longer be reclaimed, the budget is not enforced again until
+// an entry of a governed cache becomes unused, or until the budget or
+// the set of governed caches changes.
+//
+// The estimate counts each entry's value separately, even if the
+// value is shared (see cache_option::deduplicate_values), and it does
+// not account for compression.
+//
+// The governor reclaims memory from a cache on whichever thread
+// triggered the reclamation, concurrently with that cache's other
+// member functions.  The cache functions that must not be called
+// concurrently with any other member function (reserve and
+// shrink_to_fit) suspend reclaiming for their duration, so that they
+// remain safe to call while other governed caches are in use.
+//
+// A cache leaves its governor upon destruction.  The governor must
+// outlive all caches that have joined it.
+// ===================================================================
+
+#include "cetlib_except/exception.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace cet {
+
+  template <typename K, typename V>
+  class concurrent_cache;
+
+  namespace detail {
+    class governed_cache {
+    public:
+      virtual ~governed_cache() = default;
+
+      virtual std::size_t memory_usage() const = 0;
+
+      // Drops unused entries, oldest first, until at least 'bytes'
+      // have been reclaimed.  Returns the number of bytes reclaimed.
+      virtual std::size_t reclaim(std::size_t bytes) = 0;
+    };
+  }
+
+  class memory_governor {
+  public:
+    explicit memory_governor(std::size_t const budget) : budget_{budget} {}
+    memory_governor(memory_governor const&) = delete;
+    memory_governor& operator=(memory_governor const&) = delete;
+
+    std::size_t
+    budget() const noexcept
+    {
+      return budget_.load();
+    }
+
+    void
+    set_budget(std::size_t const budget)
+    {
+      budget_ = budget;
+      stalled_ = false;
+      enforce();
+    }
+
+    std::size_t
+    usage() const noexcept
+    {
+      return usage_.load();
+    }
+
+    std::size_t
+    size() const
+    {
+      std::lock_guard lock{mutex_};
+      return std::size(members_);
+    }
+
+    // Reclaims memory from the governed caches until the total usage
+    // is within budget, or until no more memory can be reclaimed.
+    void
+    enforce()
+    {
+      if (usage_.load() <= budget_.load()) {
+        return;
+      }
+      // Nothing has become reclaimable since the last attempt failed.
+      if (stalled_.load() and not released_.load()) {
+        return;
+      }
+      std::lock_guard lock{mutex_};
+      // Entries released from here on may be missed by the scans below;
+      // they re-arm the next call.
+      released_ = false;
+      stalled_ = false;
+      auto candidates = members_;
+      while (not std::empty(candidates)) {
+        auto const total = usage_.load();
+        auto const budget = budget_.load();
+        if (total <= budget) {
+          return;
+        }
+        std::sort(begin(candidates), end(candidates), [](auto const& a, auto const& b) {
+          return a.load() > b.load();
+        });
+        auto& heaviest = candidates.front();
+        auto const usage = heaviest.cache->memory_usage();
+        auto const excess = total - budget;
+
+        // Reclaim down to the weighted usage of the next-heaviest
+        // cache, but no more than the excess, and at least one entry.
+        std::size_t const target =
+          std::size(candidates) > 1u ? candidates[1].load() * heaviest.weight : 0.;
+        auto const request = std::max(std::min(usage - std::min(usage, target), excess),
+                                      std::size_t{1});
+        if (heaviest.cache->reclaim(request) == 0u) {
+          // Nothing more can be reclaimed from this cache.
+          candidates.erase(begin(candidates));
+        }
+      }
+      stalled_ = true;
+    }
+
+  private:
+    template <typename, typename>
+    friend class concurrent_cache;
+
+    struct member {
+      detail::governed_cache* cache;
+      double weight;
+
+      double
+      load() const
+      {
+        return cache->memory_usage() / weight;
+      }
+    };
+
+    void
+    join_(detail::governed_cache& cache, double const weight)
+    {
+      if (not(weight > 0.)) {
+        throw cet::exception("Cache configuration error.")
+          << "The weight of a governed cache must be positive.";
+      }
+      std::lock_guard lock{mutex_};
+      members_.push_back(member{&cache, weight});
+      usage_ += cache.memory_usage();
+      stalled_ = false;
+    }
+
+    void
+    leave_(detail::governed_cache& cache)
+    {
+      std::lock_guard lock{mutex_};
+      members_.erase(std::remove_if(begin(members_),
+                                    end(members_),
+                                    [&cache](auto const& m) { return m.cache == &cache; }),
+                     end(members_));
+      usage_ -= cache.memory_usage();
+      stalled_ = false;
+    }
+
+    // Reclaiming (from any cache) is suspended while the returned lock
+    // is held.  Must not be called by a thread that is emplacing into
+    // or reclaiming from a governed cache.
+    [[nodiscard]] std::unique_lock<std::mutex>
+    suspend_()
+    {
+      return std::unique_lock{mutex_};
+    }
+
+    void
+    charge_(std::size_t const bytes) noexcept
+    {
+      usage_ += bytes;
+    }
+
+    void
+    credit_(std::size_t const bytes) noexcept
+    {
+      usage_ -= bytes;
+    }
+
+    std::atomic<std::size_t> budget_;
+    std::atomic<std::size_t> usage_{};
+    std::atomic<bool> stalled_{false};  // Reclaiming made no progress
+    std::atomic<bool> released_{false}; // An entry has since become unused
+    mutable std::mutex mutex_;
+    std::vector<member> members_;
+  };
+}
+
+#endif /* cetlib_memory_governor_h */
+
+// Local Variables:
+// mode: c++
+// End:
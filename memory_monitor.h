@@ -0,0 +1,252 @@
+#ifndef cetlib_memory_monitor_h
+#define cetlib_memory_monitor_h
+
+// ===================================================================
+// A memory_monitor adjusts the budget of a memory_governor (see
+// memory_governor.h) according to the memory used by the whole
+// process, relative to the process's memory limit:
+//
+//   memory_governor governor{budget_in_bytes};
+//   memory_monitor monitor{governor, memory_watermarks{0.8, 0.9}};
+//   monitor.start(std::chrono::seconds{1}); // Or call poll() as desired
+//
+// Whenever the process's usage reaches the high watermark (a fraction
+// of the limit), the governor's budget is lowered so that the
+// governed caches shed enough unused entries to bring the usage back
+// to the low watermark.  Once the usage falls below the low
+// watermark, the budget is raised again to the memory used by the
+// caches plus the headroom below the low watermark, up to the
+// governor's original budget.
+//
+// By default, the usage and limit are read from the cgroup (v2) of
+// the process--i.e. from its memory.current and memory.max files.  If
+// the process's cgroup provides no usage, the resident set size from
+// /proc/self/statm is used instead.  Without a limit (e.g. if
+// memory.max is "max"), polling has no effect.  A different source of
+// readings can be provided to the monitor's constructor.
+//
+// The background thread started by start() lowers the budget, and so
+// reclaims memory from the governed caches, concurrently with the
+// other threads.  That is safe for all member functions of the
+// caches that may be called concurrently anyway, and for reserve and
+// shrink_to_fit (see memory_governor.h).  While the monitor is
+// running, however, caches must not join its governor.  The source
+// of readings is called on the background thread, and start() and
+// stop() must not be called concurrently with each other.  If the
+// source or the reclamation throws on the background thread, polling
+// stops and stop() rethrows the exception; the destructor discards
+// it.
+//
+// The governor must outlive the monitor.
+// ===================================================================
+
+#include "cetlib/memory_governor.h"
+#include "cetlib_except/exception.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <unistd.h>
+
+namespace cet {
+
+  struct memory_reading {
+    std::size_t current{}; // Bytes used by the process
+    std::size_t limit{};   // Zero if the process has no limit
+  };
+
+  struct memory_watermarks {
+    double low{0.8};  // Fractions of the limit
+    double high{0.9};
+  };
+
+  namespace detail {
+    // Returns std::nullopt if the file cannot be read or if it does
+    // not hold a number (e.g. "max").
+    inline std::optional<std::size_t>
+    read_memory_value(std::string const& path)
+    {
+      std::ifstream file{path};
+      std::size_t value{};
+      if (file >> value) {
+        return value;
+      }
+      return std::nullopt;
+    }
+
+    // The cgroup v2 entry of /proc/self/cgroup reads "0::/path".
+    inline std::optional<std::string>
+    cgroup_directory()
+    {
+      std::ifstream file{"/proc/self/cgroup"};
+      for (std::string line; std::getline(file, line);) {
+        if (line.rfind("0::", 0) == 0) {
+          return "/sys/fs/cgroup" + line.substr(3);
+        }
+      }
+      return std::nullopt;
+    }
+
+    inline std::optional<std::size_t>
+    resident_set_size()
+    {
+      std::ifstream file{"/proc/self/statm"};
+      std::size_t size{}, resident{};
+      if (file >> size >> resident) {
+        return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+      }
+      return std::nullopt;
+    }
+  }
+
+  inline memory_reading
+  process_memory()
+  {
+    memory_reading result;
+    std::optional<std::size_t> current;
+    if (auto const dir = detail::cgroup_directory()) {
+      result.limit = detail::read_memory_value(*dir + "/memory.max").value_or(0);
+      current = detail::read_memory_value(*dir + "/memory.current");
+    }
+    result.current = current ? *current : detail::resident_set_size().value_or(0);
+    return result;
+  }
+
+  class memory_monitor {
+  public:
+    using source_t = std::function<memory_reading()>;
+
+    memory_monitor(memory_governor& governor,
+                   memory_watermarks const watermarks = {},
+                   source_t source = process_memory)
+      : governor_{governor}
+      , watermarks_{watermarks}
+      , source_{std::move(source)}
+      , nominal_budget_{governor.budget()}
+    {
+      if (not(0. < watermarks_.low and watermarks_.low <= watermarks_.high and
+              watermarks_.high <= 1.)) {
+        throw cet::exception("Cache configuration error.")
+          << "The memory watermarks must satisfy 0 < low <= high <= 1.";
+      }
+    }
+
+    memory_monitor(memory_monitor const&) = delete;
+    memory_monitor& operator=(memory_monitor const&) = delete;
+
+    ~memory_monitor() { join_(); }
+
+    // Reads the process's memory and adjusts the governor's budget.
+    // Returns the reading.
+    memory_reading
+    poll()
+    {
+      std::lock_guard lock{poll_mutex_};
+      auto const reading = source_();
+      if (reading.limit == 0u) {
+        return reading;
+      }
+
+      auto const high = static_cast<std::size_t>(reading.limit * watermarks_.high);
+      auto const low = static_cast<std::size_t>(reading.limit * watermarks_.low);
+      if (reading.current >= high) {
+        // Shed the caches' share of the excess over the low watermark.
+        auto const excess = reading.current - low;
+        auto const cached = governor_.usage();
+        governor_.set_budget(cached - std::min(cached, excess));
+      }
+      else if (reading.current < low) {
+        // Give back the headroom below the low watermark.  As for
+        // shedding, the budget follows what the caches actually use,
+        // so that repeated polls do not hand out the same headroom
+        // again.
+        auto const headroom = low - reading.current;
+        auto const cached = governor_.usage();
+        auto const budget = std::min(nominal_budget_, cached + headroom);
+        if (budget > governor_.budget()) {
+          governor_.set_budget(budget);
+        }
+      }
+      return reading;
+    }
+
+    // Polls periodically on a background thread until stop() is
+    // called.
+    template <typename Rep, typename Period>
+    void
+    start(std::chrono::duration<Rep, Period> const& period)
+    {
+      if (poller_.joinable()) {
+        throw cet::exception("Cache configuration error.")
+          << "The memory monitor has already been started.";
+      }
+      stopping_ = false;
+      poller_ = std::thread{[this, period] {
+        std::unique_lock lock{thread_mutex_};
+        while (not stopping_) {
+          try {
+            poll();
+          }
+          catch (...) {
+            error_ = std::current_exception();
+            return;
+          }
+          stop_requested_.wait_for(lock, period, [this] { return stopping_; });
+        }
+      }};
+    }
+
+    // Rethrows the exception that stopped the background thread, if
+    // any.
+    void
+    stop()
+    {
+      join_();
+      if (auto error = std::exchange(error_, nullptr)) {
+        std::rethrow_exception(error);
+      }
+    }
+
+  private:
+    void
+    join_()
+    {
+      {
+        std::lock_guard lock{thread_mutex_};
+        stopping_ = true;
+      }
+      stop_requested_.notify_all();
+      if (poller_.joinable()) {
+        poller_.join();
+      }
+    }
+
+    memory_governor& governor_;
+    memory_watermarks const watermarks_;
+    source_t const source_;
+    std::size_t const nominal_budget_;
+
+    std::mutex poll_mutex_;
+    std::mutex thread_mutex_;
+    std::condition_variable stop_requested_;
+    bool stopping_{false};
+    std::exception_ptr error_; // Written only by the background thread
+    std::thread poller_;
+  };
+}
+
+#endif /* cetlib_memory_monitor_h */
+
+// Local Variables:
+// mode: c++
+// End:
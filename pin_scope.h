@@ -0,0 +1,126 @@
+#ifndef cetlib_pin_scope_h
+#define cetlib_pin_scope_h
+
+// ====================================================================
+// A pin_scope binds the lookups into one concurrent cache to a unit of
+// work--e.g. the processing of one event on one schedule.  Values
+// retrieved through the scope are returned as plain references that
+// remain valid until the scope is closed:
+//
+//   concurrent_cache<K, V> cache;
+//   ...
+//   pin_scope scope{cache};  // E.g. created at the start of an event
+//   V const& v = scope.at(key);
+//   V const& w = scope.entry_for(event_number);
+//   ...
+//   scope.close();           // Or upon destruction of the scope
+//
+// Each entry is pinned once per scope.  Repeated lookups of the same
+// key (or of values supported by an already retrieved interval key)
+// are served from the scope itself, without consulting the cache and
+// without touching any reference count.
+//
+// The at(...) and entry_for(...) functions throw if no corresponding
+// entry exists; the find(...) and find_for(...) functions instead
+// return a null pointer.
+//
+// A pin_scope may be used by only one thread at a time.  It must not
+// outlive the cache it is bound to.
+// ====================================================================
+
+#include "cetlib/concurrent_cache.h"
+#include "cetlib/pinned_set.h"
+#include "cetlib_except/exception.h"
+
+#include <utility>
+#include <vector>
+
+namespace cet {
+
+  template <typename K, typename V>
+  class pin_scope {
+  public:
+    using cache_t = concurrent_cache<K, V>;
+
+    explicit pin_scope(cache_t const& cache) : cache_{&cache} {}
+
+    V const*
+    find(K const& k)
+    {
+      for (auto const& [key, value] : retrieved_) {
+        if (key == k) {
+          return value;
+        }
+      }
+      return remember_(k, cache_->at(k, pins_));
+    }
+
+    template <typename T>
+    V const*
+    find_for(T const& t)
+    {
+      for (auto const& [key, value] : retrieved_) {
+        if (key.supports(t)) {
+          return value;
+        }
+      }
+      auto const key = cache_->key_for_(t);
+      if (not key) {
+        return nullptr;
+      }
+      return remember_(*key, cache_->at(*key, pins_));
+    }
+
+    V const&
+    at(K const& k)
+    {
+      if (auto const* value = find(k)) {
+        return *value;
+      }
+      throw cet::exception("Data retrieval error.") << "No cache entry exists for the key.";
+    }
+
+    template <typename T>
+    V const&
+    entry_for(T const& t)
+    {
+      if (auto const* value = find_for(t)) {
+        return *value;
+      }
+      throw cet::exception("Data retrieval error.") << "No cache entry supports the value.";
+    }
+
+    // Releases all entries pinned by the scope.  All references
+    // obtained through the scope become invalid.
+    void
+    close() noexcept
+    {
+      retrieved_.clear();
+      pins_.clear();
+    }
+
+  private:
+    V const*
+    remember_(K const& k, cache_view<V> const view)
+    {
+      if (not view) {
+        return nullptr;
+      }
+      retrieved_.emplace_back(k, &*view);
+      return &*view;
+    }
+
+    cache_t const* cache_;
+    pinned_set<V> pins_;
+    std::vector<std::pair<K, V const*>> retrieved_;
+  };
+
+  template <typename K, typename V>
+  pin_scope(concurrent_cache<K, V> const&) -> pin_scope<K, V>;
+}
+
+#endif /* cetlib_pin_scope_h */
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,133 @@
+#ifndef cetlib_pinned_set_h
+#define cetlib_pinned_set_h
+
+// ====================================================================
+// A pinned_set holds references to many entries of a concurrent
+// cache, keeping them pinned for the lifetime of the set.  It is
+// intended for cases where one unit of work (e.g. an event) requires
+// several entries from the same cache:
+//
+//   concurrent_cache<K, V> cache;
+//   pinned_set<V> pins;
+//   auto v1 = cache.at(key1, pins);
+//   auto v2 = cache.entry_for(value, pins);
+//   ...
+//   v1->some_member_function_of_type_V();
+//
+// Each distinct entry is pinned (i.e. its reference count is
+// incremented) only once, no matter how many times it is looked up
+// through the set.  All entries are released in one pass when the set
+// is cleared or destroyed.
+//
+// The lookups return cache_view objects, which are non-owning
+// references to the entries' values.  A cache_view is valid until the
+// set that produced it is cleared or destroyed.
+//
+// A pinned_set may be used by only one thread at a time.  It must not
+// outlive the cache whose entries it holds.
+// ====================================================================
+
+#include "cetlib/concurrent_cache_entry.h"
+#include "cetlib_except/exception.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace cet {
+
+  template <typename V>
+  class cache_view {
+  public:
+    cache_view() = default;
+    explicit cache_view(V const& value) noexcept : value_{&value} {}
+
+    explicit operator bool() const noexcept { return value_ != nullptr; }
+
+    V const&
+    operator*() const
+    {
+      if (value_ == nullptr) {
+        throw exception("Invalid cache view dereference.")
+          << "View does not refer to any cache entry.";
+      }
+      return *value_;
+    }
+
+    V const*
+    operator->() const
+    {
+      return &this->operator*();
+    }
+
+  private:
+    V const* value_{nullptr};
+  };
+
+  template <typename K, typename V>
+  class concurrent_cache;
+
+  template <typename V>
+  class pinned_set {
+  public:
+    pinned_set() = default;
+    pinned_set(pinned_set const&) = delete;
+    pinned_set& operator=(pinned_set const&) = delete;
+    pinned_set(pinned_set&&) = default;
+    pinned_set&
+    operator=(pinned_set&& other) noexcept
+    {
+      clear();
+      entries_ = std::move(other.entries_);
+      return *this;
+    }
+
+    ~pinned_set() { clear(); }
+
+    std::size_t
+    size() const noexcept
+    {
+      return std::size(entries_);
+    }
+
+    bool
+    empty() const noexcept
+    {
+      return std::empty(entries_);
+    }
+
+    void
+    clear() noexcept
+    {
+      for (auto* entry : entries_) {
+        entry->decrement_reference_count();
+      }
+      entries_.clear();
+    }
+
+  private:
+    template <typename, typename>
+    friend class concurrent_cache;
+
+    // The caller must guarantee that the entry cannot be erased while
+    // this function executes (see cache_handle).
+    cache_view<V>
+    pin_(detail::concurrent_cache_entry<V>& entry)
+    {
+      // The number of entries is expected to be small; a linear search
+      // is cheaper than maintaining a hashed container.
+      if (std::find(cbegin(entries_), cend(entries_), &entry) == cend(entries_)) {
+        entry.increment_reference_count();
+        entries_.push_back(&entry);
+      }
+      return cache_view<V>{entry.get()};
+    }
+
+    std::vector<detail::concurrent_cache_entry<V>*> entries_;
+  };
+}
+
+#endif /* cetlib_pinned_set_h */
+
+// Local Variables:
+// mode: c++
+// End:
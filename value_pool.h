@@ -0,0 +1,88 @@
+#ifndef cetlib_value_pool_h
+#define cetlib_value_pool_h
+
+// ===================================================================
+// The value_pool class template is a content-addressed store of
+// immutable values, used by the concurrent_cache to share one payload
+// among all entries whose values compare equal.  The pool does not
+// own the values--it holds weak references to them, so that a value
+// is destroyed as soon as the last cache entry referring to it is
+// erased.
+//
+// N.B. This is not intended to be user-facing.
+// ===================================================================
+
+#include "cetlib/cache_value_hash.h"
+
+#include "tbb/concurrent_hash_map.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace cet::detail {
+
+  template <typename T>
+  class value_pool {
+    using payloads_t = std::vector<std::weak_ptr<T const>>;
+    using collection_t = tbb::concurrent_hash_map<std::size_t, payloads_t>;
+
+  public:
+    // Returns the pooled value that compares equal to u, if one
+    // exists.  Otherwise, u becomes the pooled value for its hash.
+    template <typename U>
+    std::shared_ptr<T const>
+    intern(U&& u)
+    {
+      auto candidate = std::make_shared<T const>(std::forward<U>(u));
+      auto const hash = cache_value_hash<T>{}(*candidate);
+
+      // Lock held on the hash's pool entry until the function returns.
+      typename collection_t::accessor access_token;
+      values_.insert(access_token, hash);
+      auto& payloads = access_token->second;
+      for (auto it = begin(payloads); it != end(payloads);) {
+        auto existing = it->lock();
+        if (existing == nullptr) {
+          it = payloads.erase(it);
+          continue;
+        }
+        if (*existing == *candidate) {
+          return existing;
+        }
+        ++it;
+      }
+      payloads.push_back(candidate);
+      return candidate;
+    }
+
+    // Removes all references to values that no longer exist.  This
+    // function may not be called concurrently with any other.
+    void
+    prune()
+    {
+      std::vector<std::size_t> stale_hashes;
+      for (auto& [hash, payloads] : values_) {
+        payloads.erase(std::remove_if(begin(payloads),
+                                      end(payloads),
+                                      [](auto const& payload) { return payload.expired(); }),
+                       end(payloads));
+        if (std::empty(payloads)) {
+          stale_hashes.push_back(hash);
+        }
+      }
+      for (auto const hash : stale_hashes) {
+        values_.erase(hash);
+      }
+    }
+
+  private:
+    collection_t values_;
+  };
+}
+
+#endif /* cetlib_value_pool_h */
+
+// Local Variables:
+// mode: c++
+// End:
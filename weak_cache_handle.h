@@ -0,0 +1,75 @@
+#ifndef cetlib_weak_cache_handle_h
+#define cetlib_weak_cache_handle_h
+
+// ====================================================================
+// A weak_cache_handle remembers an entry of a concurrent cache without
+// pinning it--i.e. the entry's reference count is not incremented, and
+// the entry may be removed by the cache's drop_unused* functions.  A
+// typical use is to memoize the entry used for the previous event:
+//
+//   weak_cache_handle<V> last;
+//   ...
+//   auto h = last.lock();
+//   if (not h) {
+//     h = cache.entry_for(event);
+//     last = h;
+//   }
+//
+// The lock() call returns a valid handle if the entry still exists,
+// and an invalid handle otherwise.  It does not consult the cache: the
+// weak handle shares ownership of the entry's counter, through which
+// the entry's reference count is incremented unless the entry has been
+// marked as erased.  An entry that has been erased and later emplaced
+// again (even with the same key) is a different entry; weak handles to
+// the former entry are expired.
+//
+// A weak handle must not outlive the cache whose entry it refers to.
+// ====================================================================
+
+#include "cetlib/cache_handle.h"
+#include "cetlib/concurrent_cache_entry.h"
+
+namespace cet {
+
+  template <typename V>
+  class weak_cache_handle {
+  public:
+    weak_cache_handle() = default;
+    weak_cache_handle(cache_handle<V> const& h)
+      : entry_{h.entry_.get()}, count_{entry_ ? entry_->counter() : nullptr}
+    {}
+
+    cache_handle<V>
+    lock() const
+    {
+      if (count_ == nullptr or
+          not detail::concurrent_cache_entry<V>::try_acquire(*count_, *entry_)) {
+        return cache_handle<V>{};
+      }
+      return cache_handle<V>{*entry_, typename cache_handle<V>::adopt_reference_t{}};
+    }
+
+    bool
+    expired() const noexcept
+    {
+      return count_ == nullptr or count_->use_count == detail::entry_count::erased;
+    }
+
+    void
+    reset() noexcept
+    {
+      entry_ = nullptr;
+      count_.reset();
+    }
+
+  private:
+    detail::concurrent_cache_entry<V>* entry_{nullptr};
+    detail::entry_count_ptr count_{nullptr};
+  };
+}
+
+#endif /* cetlib_weak_cache_handle_h */
+
+// Local Variables:
+// mode: c++
+// End: